@@ -0,0 +1,416 @@
+/*
+ * Binder transaction stress test.
+ *
+ * Starts a context manager, a number of server processes and one client
+ * process per server.  Every server registers a binder node with the
+ * context manager, its client looks the node up and then issues
+ * synchronous transactions that the server echoes back with a reply of
+ * the same size.  All pairs run at once, so the driver is exercised by
+ * many concurrent transactions between unrelated processes, which is
+ * where contention on binder_lock shows up.
+ *
+ * Usage: binder-stress [pairs [calls [bytes]]]
+ *
+ * The test becomes the binder context manager, so servicemanager must
+ * not be running ("stop" on an Android device).  Reports the aggregate
+ * transaction rate and the round trip latency distribution.
+ *
+ * Build with: gcc -O2 -o binder-stress binder-stress.c
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../../drivers/staging/android/binder.h"
+
+#define MAX_PAIRS	64
+#define MAX_BYTES	32768
+#define MAP_SIZE	(128 * 1024)
+
+enum {
+	CODE_REGISTER = 1,
+	CODE_LOOKUP,
+	CODE_ECHO,
+};
+
+struct register_msg {
+	struct flat_binder_object obj;
+	uint32_t id;
+};
+
+struct pair_result {
+	double start;
+	double end;
+};
+
+static int binder_fd;
+
+static char rbuf[1024];
+static size_t rpos, rlen;
+
+static char wbuf[512];
+static size_t wlen;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void binder_open(void)
+{
+	struct binder_version version;
+
+	binder_fd = open("/dev/binder", O_RDWR);
+	if (binder_fd < 0) {
+		perror("/dev/binder");
+		exit(1);
+	}
+	if (ioctl(binder_fd, BINDER_VERSION, &version) < 0 ||
+	    version.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder protocol version mismatch\n");
+		exit(1);
+	}
+	if (mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, binder_fd, 0) ==
+	    MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+}
+
+/* Commands are batched and handed to the driver with the next read */
+static void queue(uint32_t cmd, const void *arg, size_t size)
+{
+	memcpy(wbuf + wlen, &cmd, sizeof(cmd));
+	wlen += sizeof(cmd);
+	if (size)
+		memcpy(wbuf + wlen, arg, size);
+	wlen += size;
+}
+
+static void flush(int read)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = wlen;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.read_size = read ? sizeof(rbuf) : 0;
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)rbuf;
+	if (ioctl(binder_fd, BINDER_WRITE_READ, &bwr) < 0) {
+		perror("BINDER_WRITE_READ");
+		exit(1);
+	}
+	wlen = 0;
+	if (read) {
+		rpos = 0;
+		rlen = bwr.read_consumed;
+	}
+}
+
+static void queue_txn(uint32_t cmd, size_t handle, uint32_t code,
+		      const void *data, size_t size,
+		      const size_t *offsets, size_t nr_offsets)
+{
+	struct binder_transaction_data tr;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.target.handle = handle;
+	tr.code = code;
+	tr.data_size = size;
+	tr.offsets_size = nr_offsets * sizeof(size_t);
+	tr.data.ptr.buffer = data;
+	tr.data.ptr.offsets = offsets;
+	queue(cmd, &tr, sizeof(tr));
+}
+
+static void queue_free(const void *buffer)
+{
+	queue(BC_FREE_BUFFER, &buffer, sizeof(buffer));
+}
+
+/*
+ * Returns the next BR_TRANSACTION or BR_REPLY, taking care of the
+ * reference counting requests on our own nodes along the way.
+ */
+static uint32_t next_txn(struct binder_transaction_data *tr)
+{
+	uint32_t cmd;
+	size_t size;
+	char *arg;
+
+	for (;;) {
+		if (rpos >= rlen) {
+			flush(1);
+			continue;
+		}
+		memcpy(&cmd, rbuf + rpos, sizeof(cmd));
+		size = _IOC_SIZE(cmd);
+		arg = rbuf + rpos + sizeof(cmd);
+		rpos += sizeof(cmd) + size;
+
+		switch (cmd) {
+		case BR_TRANSACTION:
+		case BR_REPLY:
+			memcpy(tr, arg, sizeof(*tr));
+			return cmd;
+		case BR_INCREFS:
+			queue(BC_INCREFS_DONE, arg, size);
+			break;
+		case BR_ACQUIRE:
+			queue(BC_ACQUIRE_DONE, arg, size);
+			break;
+		case BR_ERROR:
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+			fprintf(stderr, "%d: transaction failed (%08x)\n",
+				getpid(), cmd);
+			exit(1);
+		default:
+			break;
+		}
+	}
+}
+
+static void manager(int ready)
+{
+	static uint32_t handles[MAX_PAIRS];
+	static struct flat_binder_object reply;
+	static const size_t offset;
+	struct binder_transaction_data tr;
+	uint32_t id;
+
+	binder_open();
+	if (ioctl(binder_fd, BINDER_SET_CONTEXT_MGR, 0) < 0) {
+		perror("BINDER_SET_CONTEXT_MGR (is servicemanager running?)");
+		exit(1);
+	}
+	queue(BC_ENTER_LOOPER, NULL, 0);
+	flush(0);
+	if (write(ready, "", 1) != 1)
+		exit(1);
+	close(ready);
+
+	for (;;) {
+		if (next_txn(&tr) != BR_TRANSACTION)
+			continue;
+
+		if (tr.code == CODE_REGISTER &&
+		    tr.data_size >= sizeof(struct register_msg)) {
+			const struct register_msg *msg = tr.data.ptr.buffer;
+
+			id = msg->id % MAX_PAIRS;
+			handles[id] = msg->obj.handle;
+			/* Keep the reference once the buffer is released */
+			queue(BC_ACQUIRE, &handles[id], sizeof(handles[id]));
+			queue_free(tr.data.ptr.buffer);
+			queue_txn(BC_REPLY, 0, 0, NULL, 0, NULL, 0);
+		} else if (tr.code == CODE_LOOKUP &&
+			   tr.data_size >= sizeof(uint32_t)) {
+			memcpy(&id, tr.data.ptr.buffer, sizeof(id));
+			id %= MAX_PAIRS;
+			queue_free(tr.data.ptr.buffer);
+			if (handles[id]) {
+				memset(&reply, 0, sizeof(reply));
+				reply.type = BINDER_TYPE_HANDLE;
+				reply.handle = handles[id];
+				queue_txn(BC_REPLY, 0, 0, &reply, sizeof(reply),
+					  &offset, 1);
+			} else {
+				queue_txn(BC_REPLY, 0, 0, NULL, 0, NULL, 0);
+			}
+		} else {
+			queue_free(tr.data.ptr.buffer);
+			queue_txn(BC_REPLY, 0, 0, NULL, 0, NULL, 0);
+		}
+	}
+}
+
+static void server(uint32_t id)
+{
+	static struct register_msg msg;
+	static const size_t offset;
+	struct binder_transaction_data tr;
+
+	binder_open();
+	queue(BC_ENTER_LOOPER, NULL, 0);
+
+	msg.obj.type = BINDER_TYPE_BINDER;
+	msg.obj.binder = &msg;
+	msg.obj.cookie = &msg;
+	msg.id = id;
+	queue_txn(BC_TRANSACTION, 0, CODE_REGISTER, &msg, sizeof(msg),
+		  &offset, 1);
+
+	for (;;) {
+		switch (next_txn(&tr)) {
+		case BR_REPLY:
+			queue_free(tr.data.ptr.buffer);
+			break;
+		case BR_TRANSACTION:
+			/* Echo straight out of the receive buffer, then free it */
+			queue_txn(BC_REPLY, 0, 0, tr.data.ptr.buffer,
+				  tr.data_size, NULL, 0);
+			queue_free(tr.data.ptr.buffer);
+			break;
+		}
+	}
+}
+
+static void client(uint32_t id, unsigned long calls, unsigned long bytes,
+		   uint32_t *latency, struct pair_result *result)
+{
+	static char payload[MAX_BYTES];
+	struct binder_transaction_data tr;
+	const struct flat_binder_object *obj;
+	uint32_t handle = 0;
+	unsigned long i;
+	double start;
+
+	binder_open();
+
+	while (!handle) {
+		queue_txn(BC_TRANSACTION, 0, CODE_LOOKUP, &id, sizeof(id),
+			  NULL, 0);
+		while (next_txn(&tr) != BR_REPLY)
+			;
+		if (tr.data_size >= sizeof(*obj)) {
+			obj = tr.data.ptr.buffer;
+			handle = obj->handle;
+			queue(BC_ACQUIRE, &handle, sizeof(handle));
+		}
+		queue_free(tr.data.ptr.buffer);
+		if (!handle) {
+			/* Server has not registered yet */
+			flush(0);
+			usleep(1000);
+		}
+	}
+
+	memset(payload, id, bytes);
+	result->start = now();
+	for (i = 0; i < calls; i++) {
+		start = now();
+		queue_txn(BC_TRANSACTION, handle, CODE_ECHO, payload, bytes,
+			  NULL, 0);
+		while (next_txn(&tr) != BR_REPLY)
+			;
+		queue_free(tr.data.ptr.buffer);
+		latency[i] = now() - start;
+	}
+	result->end = now();
+	flush(0);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long pairs = 4, calls = 10000, bytes = 128, i, total;
+	pid_t mgr, servers[MAX_PAIRS], clients[MAX_PAIRS];
+	struct pair_result *results;
+	uint32_t *latency;
+	double start, end;
+	int ready[2];
+	char c;
+
+	if (argc > 1)
+		pairs = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		calls = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		bytes = strtoul(argv[3], NULL, 0);
+	if (!pairs || pairs > MAX_PAIRS || !calls || bytes > MAX_BYTES) {
+		fprintf(stderr, "usage: %s [pairs [calls [bytes]]]\n"
+			"  pairs <= %d, bytes <= %d\n",
+			argv[0], MAX_PAIRS, MAX_BYTES);
+		return 1;
+	}
+	total = pairs * calls;
+
+	latency = mmap(NULL, total * sizeof(*latency), PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	results = mmap(NULL, pairs * sizeof(*results), PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (latency == MAP_FAILED || results == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	if (pipe(ready)) {
+		perror("pipe");
+		return 1;
+	}
+	mgr = fork();
+	if (!mgr) {
+		close(ready[0]);
+		manager(ready[1]);
+	}
+	close(ready[1]);
+	if (read(ready[0], &c, 1) != 1) {
+		waitpid(mgr, NULL, 0);
+		return 1;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		servers[i] = fork();
+		if (!servers[i])
+			server(i);
+	}
+	for (i = 0; i < pairs; i++) {
+		clients[i] = fork();
+		if (!clients[i]) {
+			client(i, calls, bytes, latency + i * calls,
+			       results + i);
+			exit(0);
+		}
+	}
+
+	for (i = 0; i < pairs; i++) {
+		int status;
+
+		waitpid(clients[i], &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			fprintf(stderr, "client %lu failed\n", i);
+	}
+	for (i = 0; i < pairs; i++)
+		kill(servers[i], SIGTERM);
+	kill(mgr, SIGTERM);
+	while (wait(NULL) > 0)
+		;
+
+	start = results[0].start;
+	end = results[0].end;
+	for (i = 1; i < pairs; i++) {
+		if (results[i].start < start)
+			start = results[i].start;
+		if (results[i].end > end)
+			end = results[i].end;
+	}
+	qsort(latency, total, sizeof(*latency), cmp_u32);
+
+	printf("%lu pairs, %lu calls of %lu bytes each\n",
+	       pairs, calls, bytes);
+	printf("throughput: %.0f transactions/s\n", total * 1e9 / (end - start));
+	printf("latency:    p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+	       latency[total / 2] / 1000, latency[total * 9 / 10] / 1000,
+	       latency[total * 99 / 100] / 1000, latency[total - 1] / 1000);
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * ION allocation latency benchmark.
+ *
+ * Times ION_IOC_ALLOC and ION_IOC_FREE for each power of two size from
+ * 1MB to 32MB.  The first allocation of a size is reported on its own:
+ * it may have to get pages from the buddy allocator, while later ones
+ * are normally served from the system heap's page pools.
+ *
+ * Usage: ion-alloc-bench [iterations [heap_mask]]
+ *
+ * heap_mask selects the heap ids to allocate from, the system heap by
+ * default.  Dropping the pools first ("echo 3 > /proc/sys/vm/drop_caches"
+ * shrinks them) makes the first allocation fully cold.
+ *
+ * Build with: gcc -O2 -o ion-alloc-bench ion-alloc-bench.c
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "../../include/linux/ion.h"
+
+static int ion_fd;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct ion_handle *ion_alloc_timed(size_t len, unsigned int mask,
+					  double *ns)
+{
+	struct ion_allocation_data data = {
+		.len = len,
+		.align = 4096,
+		.flags = mask,
+	};
+	double start = now();
+
+	if (ioctl(ion_fd, ION_IOC_ALLOC, &data) < 0) {
+		perror("ION_IOC_ALLOC");
+		exit(1);
+	}
+	*ns = now() - start;
+	return data.handle;
+}
+
+static double ion_free_timed(struct ion_handle *handle)
+{
+	struct ion_handle_data data = {
+		.handle = handle,
+	};
+	double start = now();
+
+	if (ioctl(ion_fd, ION_IOC_FREE, &data) < 0) {
+		perror("ION_IOC_FREE");
+		exit(1);
+	}
+	return now() - start;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 100, i;
+	unsigned int mask = ION_HEAP_SYSTEM_MASK;
+	size_t mb;
+
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		mask = strtoul(argv[2], NULL, 0);
+	if (!iterations || !mask) {
+		fprintf(stderr, "usage: %s [iterations [heap_mask]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	ion_fd = open("/dev/ion", O_RDWR);
+	if (ion_fd < 0) {
+		perror("/dev/ion");
+		return 1;
+	}
+
+	printf("heap mask 0x%x, %lu iterations per size\n", mask, iterations);
+	printf("   size    first alloc    alloc avg     free avg  (us)\n");
+	for (mb = 1; mb <= 32; mb *= 2) {
+		struct ion_handle *handle;
+		double first, ns, alloc = 0, freed = 0;
+
+		handle = ion_alloc_timed(mb << 20, mask, &first);
+		ion_free_timed(handle);
+
+		for (i = 0; i < iterations; i++) {
+			handle = ion_alloc_timed(mb << 20, mask, &ns);
+			alloc += ns;
+			freed += ion_free_timed(handle);
+		}
+
+		printf("%5zuMB %14.1f %12.1f %12.1f\n", mb, first / 1000,
+		       alloc / iterations / 1000, freed / iterations / 1000);
+	}
+
+	close(ion_fd);
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * zram throughput benchmark.
+ *
+ * Writes and then reads back a region of a zram device one page at a
+ * time with O_DIRECT, as swap does, from 1, 2, 4, ... threads up to the
+ * given maximum.  Each thread works on its own slice of the region.
+ * Page contents are unique and compress roughly 2:1, so neither the
+ * same filled page nor the dedup path short-circuits the compressor.
+ * The MB/s at each thread count shows how well compression scales with
+ * max_comp_streams.
+ *
+ * Usage: zram-bench [device [megabytes [max_threads]]]
+ *
+ * The device must be initialized with a disksize of at least megabytes
+ * and must not be in use; its contents are overwritten.
+ *
+ * Build with: gcc -O2 -pthread -o zram-bench zram-bench.c
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define PAGE_SIZE	4096
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	int write;
+	unsigned long first;
+	unsigned long pages;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* 16 letter alphabet: about 4 bits of entropy per byte */
+static void fill_page(char *page, unsigned long index)
+{
+	unsigned long seed = index * 2654435761UL + 1;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		page[i] = 'a' + ((seed >> 16) & 15);
+	}
+	memcpy(page, &index, sizeof(index));
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long i;
+	char *page;
+
+	if (posix_memalign((void **)&page, PAGE_SIZE, PAGE_SIZE))
+		return (void *)1;
+
+	for (i = w->first; i < w->first + w->pages; i++) {
+		off_t offset = (off_t)i * PAGE_SIZE;
+		ssize_t ret;
+
+		if (w->write) {
+			fill_page(page, i);
+			ret = pwrite(w->fd, page, PAGE_SIZE, offset);
+		} else {
+			ret = pread(w->fd, page, PAGE_SIZE, offset);
+		}
+		if (ret != PAGE_SIZE) {
+			perror(w->write ? "pwrite" : "pread");
+			return (void *)1;
+		}
+	}
+
+	free(page);
+	return NULL;
+}
+
+static double run(int fd, unsigned long pages, unsigned long threads,
+		  int write)
+{
+	struct worker *workers;
+	unsigned long per_thread = pages / threads;
+	double start;
+	unsigned long i;
+	void *ret;
+	int failed = 0;
+
+	workers = calloc(threads, sizeof(*workers));
+	if (!workers) {
+		perror("calloc");
+		exit(1);
+	}
+
+	start = now();
+	for (i = 0; i < threads; i++) {
+		workers[i].fd = fd;
+		workers[i].write = write;
+		workers[i].first = i * per_thread;
+		workers[i].pages = per_thread;
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i])) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, &ret);
+		failed |= ret != NULL;
+	}
+	start = now() - start;
+
+	free(workers);
+	if (failed)
+		exit(1);
+
+	/* MB/s over the pages actually transferred */
+	return (double)per_thread * threads * PAGE_SIZE / (1 << 20) /
+		(start / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = "/dev/zram0";
+	unsigned long megabytes = 256, max_threads, pages;
+	unsigned long threads;
+	int fd;
+
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN) * 2;
+	if (argc > 1)
+		device = argv[1];
+	if (argc > 2)
+		megabytes = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		max_threads = strtoul(argv[3], NULL, 0);
+	if (!megabytes || !max_threads) {
+		fprintf(stderr,
+			"usage: %s [device [megabytes [max_threads]]]\n",
+			argv[0]);
+		return 1;
+	}
+	pages = (megabytes << 20) / PAGE_SIZE;
+
+	fd = open(device, O_RDWR | O_DIRECT);
+	if (fd < 0) {
+		perror(device);
+		return 1;
+	}
+
+	printf("%s, %lu MB, 4 KB requests\n", device, megabytes);
+	printf("threads    write MB/s    read MB/s\n");
+	for (threads = 1; threads <= max_threads; threads *= 2) {
+		double wr, rd;
+
+		wr = run(fd, pages, threads, 1);
+		rd = run(fd, pages, threads, 0);
+		printf("%7lu %13.1f %12.1f\n", threads, wr, rd);
+	}
+
+	close(fd);
+	return 0;
+}
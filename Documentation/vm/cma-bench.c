@@ -0,0 +1,138 @@
+/*
+ * CMA allocation latency under memory pressure.
+ *
+ * Starts a memory hog that keeps rewriting a large anonymous mapping,
+ * so that migratable CMA regions are full of movable pages, and then
+ * times cma_alloc() of each power of two size from 1MB to 32MB through
+ * the cma/alloc_test DebugFS file (CONFIG_CMA_DEBUGFS).  Reports the
+ * latency percentiles of the allocation and the average of the free.
+ *
+ * Usage: cma-bench region [iterations [hog_megabytes]]
+ *
+ * region is a CMA region name as listed in the cma= setup of the board.
+ * The hog should be sized so that the page allocator has to fall back
+ * to the lent regions, roughly free memory minus a few megabytes.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define ALLOC_TEST	"/sys/kernel/debug/cma/alloc_test"
+
+static void hog(unsigned long length, int ready)
+{
+	unsigned long page_size = sysconf(_SC_PAGESIZE), i;
+	char *addr;
+
+	addr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	for (i = 0; i < length; i += page_size)
+		addr[i] = 1;
+	if (write(ready, "", 1) != 1)
+		exit(1);
+
+	/* Keep the pages in use until killed */
+	for (;;)
+		for (i = 0; i < length; i += page_size)
+			addr[i]++;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 50, hog_mb = 64, mb, i;
+	long long *alloc_ns, free_ns, total_free;
+	char cmd[64], result[64];
+	int fd, ready[2], ret = 1;
+	pid_t pid;
+	char c;
+
+	if (argc > 2)
+		iterations = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		hog_mb = strtoul(argv[3], NULL, 0);
+	if (argc < 2 || !iterations) {
+		fprintf(stderr,
+			"usage: %s region [iterations [hog_megabytes]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	fd = open(ALLOC_TEST, O_RDWR);
+	if (fd < 0) {
+		perror(ALLOC_TEST);
+		return 1;
+	}
+	alloc_ns = calloc(iterations, sizeof(*alloc_ns));
+	if (!alloc_ns) {
+		perror("calloc");
+		return 1;
+	}
+
+	if (pipe(ready)) {
+		perror("pipe");
+		return 1;
+	}
+	pid = fork();
+	if (!pid) {
+		close(ready[0]);
+		hog(hog_mb << 20, ready[1]);
+	}
+	close(ready[1]);
+	if (read(ready[0], &c, 1) != 1) {
+		fprintf(stderr, "memory hog failed\n");
+		return 1;
+	}
+
+	printf("region %s, %lu MB hog, %lu allocations per size\n",
+	       argv[1], hog_mb, iterations);
+	printf("   size   alloc p50     p90     p99     max   free avg  (us)\n");
+	for (mb = 1; mb <= 32; mb *= 2) {
+		total_free = 0;
+		for (i = 0; i < iterations; i++) {
+			snprintf(cmd, sizeof(cmd), "%s %luM", argv[1], mb);
+			if (write(fd, cmd, strlen(cmd)) < 0) {
+				perror("cma alloc");
+				goto out;
+			}
+			memset(result, 0, sizeof(result));
+			if (pread(fd, result, sizeof(result) - 1, 0) <= 0 ||
+			    sscanf(result, "%lld %lld", &alloc_ns[i],
+				   &free_ns) != 2) {
+				fprintf(stderr, "bad result: %s\n", result);
+				goto out;
+			}
+			total_free += free_ns;
+		}
+		qsort(alloc_ns, iterations, sizeof(*alloc_ns), cmp_ll);
+		printf("%5luMB %11lld %7lld %7lld %7lld %10lld\n", mb,
+		       alloc_ns[iterations / 2] / 1000,
+		       alloc_ns[iterations * 9 / 10] / 1000,
+		       alloc_ns[iterations * 99 / 100] / 1000,
+		       alloc_ns[iterations - 1] / 1000,
+		       total_free / (long long)iterations / 1000);
+	}
+	ret = 0;
+
+out:
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,114 @@
+/*
+ * TLB miss microbenchmark for transparent huge pages.
+ *
+ * Maps an anonymous region twice, once with MADV_HUGEPAGE and once with
+ * MADV_NOHUGEPAGE, and reads one word from a random page at a time, so
+ * that nearly every access misses the TLB once the region is larger
+ * than the TLB reach with regular pages.  The difference in the time
+ * per access is what huge pages save.
+ *
+ * Usage: thp-tlb-bench [megabytes [accesses]]
+ *
+ * Transparent huge pages must be enabled in "always" or "madvise" mode;
+ * thp_fault_alloc in /proc/vmstat shows whether the huge run got them.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE	14
+#endif
+#ifndef MADV_NOHUGEPAGE
+#define MADV_NOHUGEPAGE	15
+#endif
+
+/* Large enough for any huge page size in use */
+#define ALIGN_SIZE	(4UL*1024*1024)
+
+static unsigned long page_size;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *map_region(unsigned long length, int advice)
+{
+	char *addr, *aligned;
+
+	addr = mmap(NULL, length + ALIGN_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	/* Huge pages can only back naturally aligned ranges */
+	aligned = (char *)(((uintptr_t)addr + ALIGN_SIZE - 1) &
+			   ~(ALIGN_SIZE - 1));
+	if (madvise(aligned, length, advice))
+		perror("madvise");
+
+	return aligned;
+}
+
+static double run(unsigned long length, unsigned long accesses, int advice)
+{
+	unsigned long pages = length / page_size;
+	unsigned long i, seed = 1, sum = 0;
+	char *addr;
+	double start;
+
+	addr = map_region(length, advice);
+	for (i = 0; i < length; i += page_size)
+		addr[i] = (char)i;
+
+	start = now();
+	for (i = 0; i < accesses; i++) {
+		/* Linear congruential: cheap and not prefetchable */
+		seed = seed * 1103515245 + 12345;
+		sum += addr[((seed >> 8) % pages) * page_size];
+	}
+	start = now() - start;
+
+	/* Keep the loop from being optimized away */
+	if (sum == 1)
+		printf("\n");
+
+	munmap(addr, length);
+	return start / accesses;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long length = 64, accesses = 10000000;
+	double small, huge;
+
+	if (argc > 1)
+		length = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		accesses = strtoul(argv[2], NULL, 0);
+	if (!length || !accesses) {
+		fprintf(stderr, "usage: %s [megabytes [accesses]]\n", argv[0]);
+		return 1;
+	}
+	length <<= 20;
+	page_size = sysconf(_SC_PAGESIZE);
+
+	small = run(length, accesses, MADV_NOHUGEPAGE);
+	huge = run(length, accesses, MADV_HUGEPAGE);
+
+	printf("%lu MB, %lu random accesses\n", length >> 20, accesses);
+	printf("regular pages: %.2f ns per access\n", small);
+	printf("huge pages:    %.2f ns per access\n", huge);
+	printf("saved:         %.1f%%\n", 100.0 * (small - huge) / small);
+
+	return 0;
+}
@@ -330,11 +330,120 @@ static inline pte_t *pmd_page_vaddr(pmd_t pmd)
 	return __va(pmd_val(pmd) & PAGE_MASK);
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define pmd_page(pmd)		pfn_to_page(__phys_to_pfn(pmd_val(pmd) & \
+				(pmd_trans_huge(pmd) ? SECTION_MASK : PAGE_MASK)))
+#else
 #define pmd_page(pmd)		pfn_to_page(__phys_to_pfn(pmd_val(pmd)))
+#endif
 
 /* we don't need complex calculations here as the pmd is folded into the pgd */
 #define pmd_addr_end(addr,end)	(end)
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Transparent huge pages are mapped by the pair of 1MB sections making up
+ * a Linux pmd.  A section descriptor has no room for a Linux version of
+ * it, so its hardware bits double as the Linux state: APX clear means
+ * writable, AP_READ means user accessible, XN means not executable.  There
+ * is no dirty bit, so huge pmds are always dirty.
+ *
+ * TEX remap, which ARMv7 kernels always enable, leaves TEX[2:1] to
+ * software.  TEX[1] is a young bit: set when the pmd is made and when it
+ * is touched by a fault or get_user_pages(), cleared by reclaim.  There
+ * is no access flag for the hardware to set it on plain accesses.
+ * TEX[2] marks a pmd being split.
+ *
+ * Splitting briefly makes the pmd not present by clearing its type bits
+ * and keeping the others, so a pmd is huge whenever it is neither empty
+ * nor a page table.
+ */
+#define HPAGE_SHIFT		PMD_SHIFT
+#define HPAGE_SIZE		(_AC(1, UL) << HPAGE_SHIFT)
+#define HPAGE_MASK		(~(HPAGE_SIZE - 1))
+
+#define PMD_SECT_YOUNG		PMD_SECT_TEX(2)
+#define PMD_SECT_SPLITTING	PMD_SECT_TEX(4)
+
+/* Section bits for user memory, set up with the memory types */
+extern unsigned long pmd_user_sect;
+
+#define has_transparent_hugepage()	1
+
+#define pmd_trans_huge(pmd)	\
+	(pmd_val(pmd) && !(pmd_val(pmd) & PMD_TYPE_TABLE))
+#define pmd_trans_splitting(pmd) (pmd_val(pmd) & PMD_SECT_SPLITTING)
+#define pmd_write(pmd)		(!(pmd_val(pmd) & PMD_SECT_APX))
+#define pmd_young(pmd)		(pmd_val(pmd) & PMD_SECT_YOUNG)
+#define pmd_dirty(pmd)		(1)
+#define pmd_pfn(pmd)		__phys_to_pfn(pmd_val(pmd) & SECTION_MASK)
+
+#define PMD_BIT_FUNC(fn,op) \
+static inline pmd_t pmd_##fn(pmd_t pmd) { pmd_val(pmd) op; return pmd; }
+
+PMD_BIT_FUNC(wrprotect,	|= PMD_SECT_APX);
+PMD_BIT_FUNC(mkwrite,	&= ~PMD_SECT_APX);
+PMD_BIT_FUNC(mksplitting, |= PMD_SECT_SPLITTING);
+PMD_BIT_FUNC(mknotpresent, &= ~PMD_TYPE_MASK);
+PMD_BIT_FUNC(mkhuge,	|= PMD_TYPE_SECT);
+PMD_BIT_FUNC(mkold,	&= ~PMD_SECT_YOUNG);
+PMD_BIT_FUNC(mkyoung,	|= PMD_SECT_YOUNG);
+
+static inline pmd_t pmd_mkdirty(pmd_t pmd) { return pmd; }
+
+static inline pmd_t pmd_modify(pmd_t pmd, pgprot_t newprot)
+{
+	const unsigned long mask = PMD_SECT_APX | PMD_SECT_AP_READ |
+				   PMD_SECT_XN;
+	unsigned long prot = 0;
+
+	if (pgprot_val(newprot) & L_PTE_RDONLY)
+		prot |= PMD_SECT_APX;
+	if (pgprot_val(newprot) & L_PTE_USER)
+		prot |= PMD_SECT_AP_READ;
+	if (pgprot_val(newprot) & L_PTE_XN)
+		prot |= PMD_SECT_XN;
+	pmd_val(pmd) = (pmd_val(pmd) & ~mask) | prot;
+	return pmd;
+}
+
+#define mk_pmd(page,prot)	\
+	pmd_modify(__pmd(page_to_phys(page) | pmd_user_sect | \
+			 PMD_SECT_YOUNG), prot)
+
+extern void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		       pmd_t *pmdp, pmd_t pmd);
+extern void __sync_icache_dcache_pmd(pmd_t pmd);
+
+#define __HAVE_ARCH_PMDP_GET_AND_CLEAR
+static inline pmd_t pmdp_get_and_clear(struct mm_struct *mm,
+				       unsigned long addr, pmd_t *pmdp)
+{
+	pmd_t pmd = *pmdp;
+
+	pmd_clear(pmdp);
+	return pmd;
+}
+
+struct vm_area_struct;
+
+#define __HAVE_ARCH_PMDP_TEST_AND_CLEAR_YOUNG
+extern int pmdp_test_and_clear_young(struct vm_area_struct *vma,
+				     unsigned long addr, pmd_t *pmdp);
+
+/* The hardware ignores the young bit: no TLB entry to flush */
+#define __HAVE_ARCH_PMDP_CLEAR_YOUNG_FLUSH
+static inline int pmdp_clear_flush_young(struct vm_area_struct *vma,
+					 unsigned long addr, pmd_t *pmdp)
+{
+	return pmdp_test_and_clear_young(vma, addr, pmdp);
+}
+
+#define __HAVE_ARCH_PMDP_SPLITTING_FLUSH
+extern void pmdp_splitting_flush(struct vm_area_struct *vma,
+				 unsigned long addr, pmd_t *pmdp);
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 
 #ifndef CONFIG_HIGHPTE
 #define __pte_map(pmd)		pmd_page_vaddr(*(pmd))
@@ -153,6 +153,19 @@ tlb_remove_tlb_entry(struct mmu_gather *tlb, pte_t *ptep, unsigned long addr)
 	tlb_add_flush(tlb, addr);
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Same for a huge page: both sections of the pmd were unmapped.
+ */
+static inline void
+tlb_remove_pmd_tlb_entry(struct mmu_gather *tlb, pmd_t *pmdp,
+			 unsigned long addr)
+{
+	tlb_add_flush(tlb, addr);
+	tlb_add_flush(tlb, addr + HPAGE_SIZE - PAGE_SIZE);
+}
+#endif
+
 /*
  * In the case of tlb vma handling, we can optimise these away in the
  * case where we're doing a full MM flush.  When we're doing a munmap,
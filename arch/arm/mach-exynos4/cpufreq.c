@@ -19,6 +19,7 @@
 #include <linux/cpufreq.h>
 #include <linux/suspend.h>
 #include <linux/reboot.h>
+#include <linux/sched.h>
 
 #include <mach/map.h>
 #include <mach/regs-clock.h>
@@ -135,6 +136,35 @@ static struct cpufreq_voltage_table exynos4_volt_table[CPUFREQ_LEVEL_END] = {
 	},
 };
 
+#ifdef CONFIG_SCHED_ENERGY
+/*
+ * Power of one core, estimated from f * V^2 at the voltages above and
+ * not measured: replace it with measurements for a given board.  The
+ * deepest idle state is the core powered down, as the second core is
+ * when it has been idle for long enough.
+ */
+static const struct sched_cap_state exynos4_cap_states[] = {
+	{ .cap =  171, .power =  80 },	/*  200MHz */
+	{ .cap =  427, .power = 170 },	/*  500MHz */
+	{ .cap =  683, .power = 308 },	/*  800MHz */
+	{ .cap =  853, .power = 445 },	/* 1000MHz */
+	{ .cap = 1024, .power = 657 },	/* 1200MHz */
+};
+
+static const struct sched_idle_state exynos4_idle_states[] = {
+	{ .power = 40 },		/* WFI */
+	{ .power =  5 },		/* power down */
+};
+
+static const struct sched_energy_model exynos4_energy_model = {
+	.cap_states	= exynos4_cap_states,
+	.nr_cap_states	= ARRAY_SIZE(exynos4_cap_states),
+	.idle_states	= exynos4_idle_states,
+	.nr_idle_states	= ARRAY_SIZE(exynos4_idle_states),
+	.shared_clock	= true,
+};
+#endif
+
 static unsigned int exynos4_apll_pms_table[CPUFREQ_LEVEL_END] = {
 	/* APLL FOUT L0: 1200MHz */
 	((150 << 16) | (3 << 8) | 1),
@@ -571,6 +601,11 @@ static int __init exynos4_cpufreq_init(void)
 		goto err_cpufreq;
 	}
 
+#ifdef CONFIG_SCHED_ENERGY
+	if (sched_energy_register(&exynos4_energy_model))
+		pr_err("failed to register energy model\n");
+#endif
+
 	return 0;
 err_cpufreq:
 	unregister_reboot_notifier(&exynos4_cpufreq_reboot_notifier);
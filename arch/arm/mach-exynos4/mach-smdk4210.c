@@ -802,7 +802,11 @@ static void __init exynos4_reserve_cma(void)
 		{
 			.name = "common",
 			.size = CONFIG_CMA_COMMON_MEMORY_SIZE * SZ_1K,
-			.start = 0
+			.start = 0,
+#ifdef CONFIG_CMA_MIGRATE
+			/* Lent to movable allocations while unused */
+			.migratable = 1,
+#endif
 		},
 		{}
 	};
@@ -825,11 +829,19 @@ static void __init exynos4_reserve_cma(void)
 					meminfo.bank[1].size;
 
 	for (; i < ARRAY_SIZE(regions) ; i++) {
+		dma_addr_t mask = 0;
+
+		/* Place lent regions on whole blocks, the rest packs below */
+		if (regions[i].migratable) {
+			regions[i].size = ALIGN(regions[i].size,
+						CMA_MIGRATE_ALIGN);
+			mask = CMA_MIGRATE_ALIGN - 1;
+		}
 		if (regions[i].start == 0) {
-			regions[i].start = bank0_end - regions[i].size;
+			regions[i].start = (bank0_end - regions[i].size) & ~mask;
 			bank0_end = regions[i].start;
 		} else if (regions[i].start == 1) {
-			regions[i].start = bank1_end - regions[i].size;
+			regions[i].start = (bank1_end - regions[i].size) & ~mask;
 			bank1_end = regions[i].start;
 		}
 		printk(KERN_ERR "CMA reserve : %s, addr is 0x%x, size is 0x%x\n",
@@ -257,6 +257,30 @@ void __sync_icache_dcache(pte_t pteval)
 	if (pte_exec(pteval))
 		__flush_icache_all();
 }
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Executable huge page sections need the same treatment, page by page:
+ * they are always mapped at the address the kernel maps them by.
+ */
+void __sync_icache_dcache_pmd(pmd_t pmd)
+{
+	struct page *page;
+	int i;
+
+	if (!(pmd_val(pmd) & PMD_SECT_AP_READ))
+		return;
+	if (!pfn_valid(pmd_pfn(pmd)))
+		return;
+
+	page = pfn_to_page(pmd_pfn(pmd));
+	for (i = 0; i < HPAGE_PMD_NR; i++, page++)
+		if (!test_and_set_bit(PG_dcache_clean, &page->flags))
+			__flush_dcache_page(NULL, page);
+
+	__flush_icache_all();
+}
+#endif
 #endif
 
 /*
@@ -53,6 +53,9 @@ static unsigned int cachepolicy __initdata = CPOLICY_WRITEBACK;
 static unsigned int ecc_mask __initdata = 0;
 pgprot_t pgprot_user;
 pgprot_t pgprot_kernel;
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+unsigned long pmd_user_sect;
+#endif
 
 EXPORT_SYMBOL(pgprot_user);
 EXPORT_SYMBOL(pgprot_kernel);
@@ -485,6 +488,16 @@ static void __init build_mem_type_table(void)
 	mem_types[MT_MEMORY_NONCACHED].prot_sect |= ecc_mask;
 	mem_types[MT_ROM].prot_sect |= cp->pmd;
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* Huge pages: normal memory, as the kernel maps it, for userspace */
+	pmd_user_sect = (mem_types[MT_MEMORY].prot_sect &
+			 ~(PMD_DOMAIN(0xf) | PMD_SECT_XN | PMD_SECT_APX |
+			   PMD_SECT_AP_READ | PMD_SECT_YOUNG |
+			   PMD_SECT_SPLITTING)) |
+			PMD_DOMAIN(DOMAIN_USER) | PMD_SECT_AP_WRITE |
+			PMD_SECT_nG;
+#endif
+
 	switch (cp->pmd) {
 	case PMD_SECT_WT:
 		mem_types[MT_CACHECLEAN].prot_sect |= PMD_SECT_WT;
@@ -0,0 +1,57 @@
+/*
+ *  linux/arch/arm/mm/transhuge.c
+ *
+ *  Transparent huge pages, mapped by the pair of sections of a pmd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/mm.h>
+#include <linux/huge_mm.h>
+
+#include <asm/cacheflush.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		pmd_t *pmdp, pmd_t pmd)
+{
+	unsigned long val = pmd_val(pmd);
+
+	/* Page tables go in through pmd_populate() */
+	VM_BUG_ON(val & PMD_TYPE_TABLE);
+
+#if __LINUX_ARM_ARCH__ >= 6
+	if ((val & PMD_TYPE_MASK) == PMD_TYPE_SECT && !(val & PMD_SECT_XN))
+		__sync_icache_dcache_pmd(pmd);
+#endif
+
+	pmdp[0] = __pmd(val);
+	pmdp[1] = __pmd(val ? val + SECTION_SIZE : 0);
+	flush_pmd_entry(pmdp);
+}
+
+/* Called with page_table_lock held, like the other pmd updates */
+int pmdp_test_and_clear_young(struct vm_area_struct *vma,
+			      unsigned long addr, pmd_t *pmdp)
+{
+	if (!pmd_young(*pmdp))
+		return 0;
+
+	pmdp[0] = pmd_mkold(pmdp[0]);
+	pmdp[1] = pmd_mkold(pmdp[1]);
+	flush_pmd_entry(pmdp);
+	return 1;
+}
+
+/*
+ * There is no get_user_pages_fast() to serialize against and the
+ * hardware ignores the splitting bit, so the TLB can be left alone.
+ */
+void pmdp_splitting_flush(struct vm_area_struct *vma, unsigned long addr,
+			  pmd_t *pmdp)
+{
+	VM_BUG_ON(addr & ~HPAGE_PMD_MASK);
+	set_pmd_at(vma->vm_mm, addr, pmdp, pmd_mksplitting(*pmdp));
+}
@@ -1409,6 +1409,57 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 EXPORT_SYMBOL(cpufreq_unregister_notifier);
 
 
+/*********************************************************************
+ *                          BOOST REQUESTS                           *
+ *********************************************************************/
+
+static ATOMIC_NOTIFIER_HEAD(cpufreq_boost_notifier_list);
+
+/**
+ *	cpufreq_register_boost_notifier - register a governor for boost requests
+ *	@nb: notifier function to register
+ *
+ *	The notifier is called with CPUFREQ_BOOST_PULSE, in atomic context,
+ *	whenever a boost is asked for.
+ */
+int cpufreq_register_boost_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&cpufreq_boost_notifier_list, nb);
+}
+EXPORT_SYMBOL_GPL(cpufreq_register_boost_notifier);
+
+int cpufreq_unregister_boost_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&cpufreq_boost_notifier_list,
+						nb);
+}
+EXPORT_SYMBOL_GPL(cpufreq_unregister_boost_notifier);
+
+/**
+ *	cpufreq_boost_pulse - ask governors for a short boost
+ *
+ *	How high and for how long is up to each governor.  May be called
+ *	from any context, e.g. from an input event handler.
+ */
+void cpufreq_boost_pulse(void)
+{
+	atomic_notifier_call_chain(&cpufreq_boost_notifier_list,
+				   CPUFREQ_BOOST_PULSE, NULL);
+}
+EXPORT_SYMBOL_GPL(cpufreq_boost_pulse);
+
+/* Any write to /sys/devices/system/cpu/cpufreq/boostpulse is a pulse */
+static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
+				const char *buf, size_t count)
+{
+	cpufreq_boost_pulse();
+	return count;
+}
+
+static struct global_attr boostpulse =
+__ATTR(boostpulse, 0200, NULL, store_boostpulse);
+
+
 /*********************************************************************
  *                              GOVERNORS                            *
  *********************************************************************/
@@ -1890,6 +1941,8 @@ static int __init cpufreq_core_init(void)
 	cpufreq_global_kobject = kobject_create_and_add("cpufreq",
 						&cpu_sysdev_class.kset.kobj);
 	BUG_ON(!cpufreq_global_kobject);
+	if (sysfs_create_file(cpufreq_global_kobject, &boostpulse.attr))
+		printk(KERN_WARNING "cpufreq: cannot create boostpulse\n");
 	register_syscore_ops(&cpufreq_syscore_ops);
 
 	return 0;
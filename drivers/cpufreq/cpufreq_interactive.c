@@ -25,9 +25,13 @@
 #include <linux/timer.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 
 #include <asm/cputime.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_interactive.h>
+
 static atomic_t active_count = ATOMIC_INIT(0);
 
 struct cpufreq_interactive_cpuinfo {
@@ -72,6 +76,20 @@ static unsigned long min_sample_time;
 #define DEFAULT_TIMER_RATE 30000;
 static unsigned long timer_rate;
 
+/*
+ * Frequency not to go below while boosted, 0 for the policy maximum.
+ */
+static unsigned long boost_freq;
+
+/*
+ * How long a boost pulse lasts, in microseconds.
+ */
+#define DEFAULT_BOOSTPULSE_DURATION 80000
+static unsigned long boostpulse_duration;
+
+/* End of the last boost pulse, in ktime microseconds */
+static u64 boostpulse_endtime;
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
 
@@ -85,6 +103,26 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+/*
+ * The frequency a boost holds a cpu at: boost_freq, or the nearest
+ * frequency below it, and no higher than the policy allows.
+ */
+static unsigned int cpufreq_interactive_boost_floor(
+	struct cpufreq_interactive_cpuinfo *pcpu)
+{
+	unsigned int freq = pcpu->policy->max;
+	unsigned int index;
+
+	if (boost_freq && boost_freq < freq)
+		freq = boost_freq;
+
+	if (!cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					    freq, CPUFREQ_RELATION_H, &index))
+		freq = pcpu->freq_table[index].frequency;
+
+	return freq;
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	unsigned int delta_idle;
@@ -172,6 +210,16 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	new_freq = pcpu->freq_table[index].frequency;
 
+	if (pcpu->timer_run_time < boostpulse_endtime) {
+		unsigned int floor = cpufreq_interactive_boost_floor(pcpu);
+
+		if (new_freq < floor)
+			new_freq = floor;
+	}
+
+	trace_cpufreq_interactive_target(data, cpu_load, pcpu->target_freq,
+					 new_freq);
+
 	if (pcpu->target_freq == new_freq)
 		goto rearm_if_notmax;
 
@@ -358,6 +406,8 @@ static int cpufreq_interactive_up_task(void *data)
 			pcpu->freq_change_time_in_idle =
 				get_cpu_idle_time_us(cpu,
 						     &pcpu->freq_change_time);
+			trace_cpufreq_interactive_up(cpu, pcpu->target_freq,
+						     pcpu->policy->cur);
 		}
 	}
 
@@ -390,9 +440,54 @@ static void cpufreq_interactive_freq_down(struct work_struct *work)
 		pcpu->freq_change_time_in_idle =
 			get_cpu_idle_time_us(cpu,
 					     &pcpu->freq_change_time);
+		trace_cpufreq_interactive_down(cpu, pcpu->target_freq,
+					       pcpu->policy->cur);
+	}
+}
+
+/*
+ * Raise every cpu below its boost floor right away, rather than waiting
+ * for the timer to see the load.  Called in atomic context.
+ */
+static int cpufreq_interactive_boost_notifier(struct notifier_block *nb,
+					      unsigned long val, void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned int cpu, floor;
+	unsigned long flags;
+	int anyboost = 0;
+
+	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration;
+	trace_cpufreq_interactive_boost(boost_freq, boostpulse_duration);
+
+	spin_lock_irqsave(&up_cpumask_lock, flags);
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+
+		smp_rmb();
+
+		if (!pcpu->governor_enabled)
+			continue;
+
+		floor = cpufreq_interactive_boost_floor(pcpu);
+		if (pcpu->target_freq < floor) {
+			pcpu->target_freq = floor;
+			cpumask_set_cpu(cpu, &up_cpumask);
+			anyboost = 1;
+		}
 	}
+	spin_unlock_irqrestore(&up_cpumask_lock, flags);
+
+	if (anyboost)
+		wake_up_process(up_task);
+
+	return NOTIFY_OK;
 }
 
+static struct notifier_block cpufreq_interactive_boost_nb = {
+	.notifier_call = cpufreq_interactive_boost_notifier,
+};
+
 static ssize_t show_go_maxspeed_load(struct kobject *kobj,
 				     struct attribute *attr, char *buf)
 {
@@ -459,10 +554,57 @@ static ssize_t store_timer_rate(struct kobject *kobj,
 static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 		show_timer_rate, store_timer_rate);
 
+static ssize_t show_boost_freq(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boost_freq);
+}
+
+static ssize_t store_boost_freq(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	boost_freq = val;
+	return count;
+}
+
+static struct global_attr boost_freq_attr = __ATTR(boost_freq, 0644,
+		show_boost_freq, store_boost_freq);
+
+static ssize_t show_boostpulse_duration(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boostpulse_duration);
+}
+
+static ssize_t store_boostpulse_duration(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	boostpulse_duration = val;
+	return count;
+}
+
+static struct global_attr boostpulse_duration_attr =
+	__ATTR(boostpulse_duration, 0644,
+	       show_boostpulse_duration, store_boostpulse_duration);
+
 static struct attribute *interactive_attributes[] = {
 	&go_maxspeed_load_attr.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
+	&boost_freq_attr.attr,
+	&boostpulse_duration_attr.attr,
 	NULL,
 };
 
@@ -511,6 +653,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		if (rc)
 			return rc;
 
+		cpufreq_register_boost_notifier(&cpufreq_interactive_boost_nb);
 		break;
 
 	case CPUFREQ_GOV_STOP:
@@ -533,6 +676,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
+		cpufreq_unregister_boost_notifier(&cpufreq_interactive_boost_nb);
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
 
@@ -579,6 +723,7 @@ static int __init cpufreq_interactive_init(void)
 	go_maxspeed_load = DEFAULT_GO_MAXSPEED_LOAD;
 	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 	timer_rate = DEFAULT_TIMER_RATE;
+	boostpulse_duration = DEFAULT_BOOSTPULSE_DURATION;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
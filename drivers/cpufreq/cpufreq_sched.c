@@ -0,0 +1,478 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * A cpufreq governor driven by the scheduler.  Rather than sampling idle
+ * time from a timer, it is handed each cpu's utilization by the scheduler
+ * whenever that changes, at enqueue, dequeue and tick, and asks for a new
+ * frequency right away.
+ *
+ * The frequency for a policy is taken from the busiest of its cpus, with
+ * some headroom so that a cpu that is fully busy asks for more:
+ *
+ *	next_freq = 1.25 * max_freq * util / max
+ *
+ * The request itself cannot be made with the runqueue locked, so it is
+ * handed through an irq_work to a real-time thread.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+static atomic_t active_count = ATOMIC_INIT(0);
+
+struct cpufreq_sched_policy {
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+
+	/* Protects the fields below, taken from scheduler context */
+	raw_spinlock_t update_lock;
+	u64 last_freq_update_time;
+	unsigned int next_freq;
+	bool work_in_progress;
+
+	struct irq_work irq_work;
+};
+
+struct cpufreq_sched_cpu {
+	struct update_util_data update_util;
+	struct cpufreq_sched_policy *sp;
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpu, sched_cpu);
+
+/* Policies with a frequency request pending, by policy->cpu */
+static DEFINE_PER_CPU(struct cpufreq_sched_policy *, sched_policy);
+static cpumask_t pending_mask;
+static DEFINE_SPINLOCK(pending_lock);
+static struct task_struct *freq_task;
+
+/* Serialises frequency requests against the governor stopping */
+static DEFINE_MUTEX(sched_gov_mutex);
+
+/*
+ * Minimum time between two frequency requests, in microseconds, for
+ * raising and for lowering the frequency.  Lowering waits longer so that
+ * a short pause does not cost the next burst its speed.
+ */
+#define DEFAULT_UP_RATE_LIMIT	500
+static unsigned long up_rate_limit_us;
+
+#define DEFAULT_DOWN_RATE_LIMIT	20000
+static unsigned long down_rate_limit_us;
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+static unsigned int cpufreq_sched_next_freq(struct cpufreq_sched_policy *sp,
+					    unsigned long util,
+					    unsigned long max)
+{
+	struct cpufreq_policy *policy = sp->policy;
+	unsigned int freq = policy->cpuinfo.max_freq;
+	unsigned int index;
+
+	freq = div_u64((u64)(freq + (freq >> 2)) * util, max);
+	freq = clamp_val(freq, policy->min, policy->max);
+
+	if (sp->freq_table &&
+	    !cpufreq_frequency_table_target(policy, sp->freq_table, freq,
+					    CPUFREQ_RELATION_L, &index))
+		freq = sp->freq_table[index].frequency;
+
+	return freq;
+}
+
+/*
+ * Called by the scheduler with the runqueue of @cpu locked.  Other cpus
+ * of the policy count with the utilization they last reported, unless
+ * that is over a tick old: they are idle, or would have reported since.
+ */
+static void cpufreq_sched_update_util(struct update_util_data *data, int cpu,
+				      u64 time, unsigned long util,
+				      unsigned long max)
+{
+	struct cpufreq_sched_cpu *sc = container_of(data,
+					struct cpufreq_sched_cpu, update_util);
+	struct cpufreq_sched_policy *sp = sc->sp;
+	unsigned int next_freq;
+	unsigned long rate_limit;
+	unsigned int j;
+
+	raw_spin_lock(&sp->update_lock);
+
+	sc->util = util;
+	sc->max = max;
+	sc->last_update = time;
+
+	if (sp->work_in_progress)
+		goto out;
+
+	for_each_cpu(j, sp->policy->cpus) {
+		struct cpufreq_sched_cpu *jc = &per_cpu(sched_cpu, j);
+
+		if (j == cpu || time - jc->last_update > TICK_NSEC)
+			continue;
+		if (jc->util * max > util * jc->max) {
+			util = jc->util;
+			max = jc->max;
+		}
+	}
+
+	next_freq = cpufreq_sched_next_freq(sp, util, max);
+	if (next_freq == sp->next_freq)
+		goto out;
+
+	rate_limit = next_freq > sp->next_freq ?
+		up_rate_limit_us : down_rate_limit_us;
+	if (time - sp->last_freq_update_time < rate_limit * NSEC_PER_USEC)
+		goto out;
+
+	sp->next_freq = next_freq;
+	sp->last_freq_update_time = time;
+	sp->work_in_progress = true;
+	irq_work_queue(&sp->irq_work);
+out:
+	raw_spin_unlock(&sp->update_lock);
+}
+
+static void cpufreq_sched_irq_work(struct irq_work *irq_work)
+{
+	struct cpufreq_sched_policy *sp = container_of(irq_work,
+					struct cpufreq_sched_policy, irq_work);
+	unsigned long flags;
+
+	spin_lock_irqsave(&pending_lock, flags);
+	cpumask_set_cpu(sp->policy->cpu, &pending_mask);
+	spin_unlock_irqrestore(&pending_lock, flags);
+
+	wake_up_process(freq_task);
+}
+
+static int cpufreq_sched_task(void *data)
+{
+	struct cpufreq_sched_policy *sp;
+	unsigned int cpu, next_freq;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&pending_lock, flags);
+
+		if (cpumask_empty(&pending_mask)) {
+			spin_unlock_irqrestore(&pending_lock, flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&pending_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+
+		tmp_mask = pending_mask;
+		cpumask_clear(&pending_mask);
+		spin_unlock_irqrestore(&pending_lock, flags);
+
+		mutex_lock(&sched_gov_mutex);
+		for_each_cpu(cpu, &tmp_mask) {
+			sp = per_cpu(sched_policy, cpu);
+			if (!sp)
+				continue;
+
+			raw_spin_lock_irqsave(&sp->update_lock, flags);
+			next_freq = sp->next_freq;
+			raw_spin_unlock_irqrestore(&sp->update_lock, flags);
+
+			__cpufreq_driver_target(sp->policy, next_freq,
+						CPUFREQ_RELATION_L);
+
+			raw_spin_lock_irqsave(&sp->update_lock, flags);
+			sp->work_in_progress = false;
+			raw_spin_unlock_irqrestore(&sp->update_lock, flags);
+		}
+		mutex_unlock(&sched_gov_mutex);
+	}
+
+	return 0;
+}
+
+static ssize_t show_up_rate_limit_us(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", up_rate_limit_us);
+}
+
+static ssize_t store_up_rate_limit_us(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	up_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr up_rate_limit_us_attr = __ATTR(up_rate_limit_us,
+		0644, show_up_rate_limit_us, store_up_rate_limit_us);
+
+static ssize_t show_down_rate_limit_us(struct kobject *kobj,
+				       struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", down_rate_limit_us);
+}
+
+static ssize_t store_down_rate_limit_us(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	down_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr down_rate_limit_us_attr = __ATTR(down_rate_limit_us,
+		0644, show_down_rate_limit_us, store_down_rate_limit_us);
+
+static struct attribute *sched_attributes[] = {
+	&up_rate_limit_us_attr.attr,
+	&down_rate_limit_us_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+/*
+ * Hooks follow the cpus of a policy through hotplug: they are installed
+ * on every cpu the policy may cover, online or not, installed again when
+ * a cpu comes online, and removed before it goes down.  Called with
+ * sched_gov_mutex held.
+ */
+static void cpufreq_sched_set_hook(struct cpufreq_sched_policy *sp,
+				   unsigned int cpu)
+{
+	struct cpufreq_sched_cpu *sc = &per_cpu(sched_cpu, cpu);
+
+	memset(sc, 0, sizeof(*sc));
+	sc->sp = sp;
+	sc->update_util.func = cpufreq_sched_update_util;
+	cpufreq_set_update_util_data(cpu, &sc->update_util);
+}
+
+static bool cpufreq_sched_covers(struct cpufreq_sched_policy *sp,
+				 unsigned int cpu)
+{
+	return cpumask_test_cpu(cpu, sp->policy->cpus) ||
+		cpumask_test_cpu(cpu, sp->policy->related_cpus);
+}
+
+static int cpufreq_sched_start(struct cpufreq_policy *policy)
+{
+	struct cpufreq_sched_policy *sp;
+	unsigned int j;
+	int rc;
+
+	if (!cpu_online(policy->cpu))
+		return -EINVAL;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return -ENOMEM;
+
+	sp->policy = policy;
+	sp->freq_table = cpufreq_frequency_get_table(policy->cpu);
+	sp->next_freq = policy->cur;
+	raw_spin_lock_init(&sp->update_lock);
+	init_irq_work(&sp->irq_work, cpufreq_sched_irq_work);
+
+	/*
+	 * Create the sysfs entries with the first policy only.
+	 */
+	if (atomic_inc_return(&active_count) == 1) {
+		rc = sysfs_create_group(cpufreq_global_kobject,
+				&sched_attr_group);
+		if (rc) {
+			atomic_dec(&active_count);
+			kfree(sp);
+			return rc;
+		}
+	}
+
+	mutex_lock(&sched_gov_mutex);
+	per_cpu(sched_policy, policy->cpu) = sp;
+	for_each_possible_cpu(j)
+		if (cpufreq_sched_covers(sp, j))
+			cpufreq_sched_set_hook(sp, j);
+	mutex_unlock(&sched_gov_mutex);
+
+	return 0;
+}
+
+static void cpufreq_sched_stop(struct cpufreq_policy *policy)
+{
+	struct cpufreq_sched_policy *sp = per_cpu(sched_policy, policy->cpu);
+	unsigned int j;
+
+	if (!sp)
+		return;
+
+	/* Offline cpus may still point at us, whatever policy->cpus says */
+	mutex_lock(&sched_gov_mutex);
+	per_cpu(sched_policy, policy->cpu) = NULL;
+	for_each_possible_cpu(j)
+		if (per_cpu(sched_cpu, j).sp == sp)
+			cpufreq_set_update_util_data(j, NULL);
+	mutex_unlock(&sched_gov_mutex);
+
+	/* Wait for the scheduler to be done with the hooks */
+	synchronize_sched();
+	irq_work_sync(&sp->irq_work);
+
+	for_each_possible_cpu(j)
+		if (per_cpu(sched_cpu, j).sp == sp)
+			per_cpu(sched_cpu, j).sp = NULL;
+	kfree(sp);
+
+	if (atomic_dec_return(&active_count) == 0)
+		sysfs_remove_group(cpufreq_global_kobject,
+				&sched_attr_group);
+}
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		return cpufreq_sched_start(policy);
+
+	case CPUFREQ_GOV_STOP:
+		cpufreq_sched_stop(policy);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&sched_gov_mutex);
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&sched_gov_mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __cpuinit cpufreq_sched_cpu_callback(struct notifier_block *nfb,
+						unsigned long action,
+						void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	struct cpufreq_sched_policy *sp;
+	unsigned int j;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		mutex_lock(&sched_gov_mutex);
+		for_each_possible_cpu(j) {
+			sp = per_cpu(sched_policy, j);
+			if (sp && cpufreq_sched_covers(sp, cpu)) {
+				cpufreq_sched_set_hook(sp, cpu);
+				break;
+			}
+		}
+		mutex_unlock(&sched_gov_mutex);
+		break;
+	case CPU_DOWN_PREPARE:
+		/* sc->sp stays, so that the policy can still find us */
+		mutex_lock(&sched_gov_mutex);
+		cpufreq_set_update_util_data(cpu, NULL);
+		mutex_unlock(&sched_gov_mutex);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_sched_cpu_notifier __refdata = {
+	.notifier_call = cpufreq_sched_cpu_callback,
+};
+
+static int __init cpufreq_sched_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+	up_rate_limit_us = DEFAULT_UP_RATE_LIMIT;
+	down_rate_limit_us = DEFAULT_DOWN_RATE_LIMIT;
+
+	freq_task = kthread_create(cpufreq_sched_task, NULL, "kschedfreq");
+	if (IS_ERR(freq_task))
+		return PTR_ERR(freq_task);
+
+	sched_setscheduler_nocheck(freq_task, SCHED_FIFO, &param);
+	get_task_struct(freq_task);
+
+	register_hotcpu_notifier(&cpufreq_sched_cpu_notifier);
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+static void __exit cpufreq_sched_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_sched);
+	unregister_hotcpu_notifier(&cpufreq_sched_cpu_notifier);
+	kthread_stop(freq_task);
+	put_task_struct(freq_task);
+}
+
+module_exit(cpufreq_sched_exit);
+
+MODULE_DESCRIPTION("'cpufreq_sched' - A cpufreq governor driven by "
+	"scheduler utilization");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,453 @@
+/*
+ * drivers/cpufreq/cpufreq_sim.c
+ *
+ * A cpufreq driver for a made up cpu, to compare governors on any machine.
+ * Frequency changes take the transition latency and are otherwise only
+ * recorded.  A workload trace written to debugfs is replayed on one cpu
+ * and the report tells how long each burst of load took to get the
+ * maximum frequency, and how long was spent at each frequency:
+ *
+ *	cd /sys/kernel/debug/cpufreq_sim
+ *	printf "2000 8000\n30000 50000\n" > trace	(busy and idle, in us)
+ *	echo 1 > replay					(cpu to replay on)
+ *	cat report
+ *
+ * The busy time of a burst is spent spinning, so it stands for the same
+ * amount of work whatever the simulated frequency.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#define SIM_NR_FREQS		7
+#define SIM_MAX_BURSTS		4096
+
+static struct cpufreq_frequency_table sim_freq_table[] = {
+	{ 0, 200000 },
+	{ 1, 400000 },
+	{ 2, 600000 },
+	{ 3, 800000 },
+	{ 4, 1000000 },
+	{ 5, 1200000 },
+	{ 6, 1400000 },
+	{ 0, CPUFREQ_TABLE_END },
+};
+
+static unsigned int transition_us = 100;
+module_param(transition_us, uint, 0644);
+MODULE_PARM_DESC(transition_us, "Time a frequency change takes");
+
+struct sim_cpu {
+	unsigned int cur;		/* index in sim_freq_table */
+	ktime_t last_change;
+	u64 residency_ns[SIM_NR_FREQS];
+};
+
+static DEFINE_PER_CPU(struct sim_cpu, sim_cpus);
+
+/* Protects sim_cpus and the replay state below */
+static DEFINE_SPINLOCK(sim_lock);
+
+struct sim_burst {
+	unsigned int busy_us;
+	unsigned int idle_us;
+};
+
+/* Serialises trace writes and replays */
+static DEFINE_MUTEX(sim_mutex);
+static struct sim_burst sim_trace[SIM_MAX_BURSTS];
+static unsigned int sim_nr_bursts;
+
+static struct {
+	int cpu;
+	bool running;
+	bool in_burst;		/* busy and not at the maximum yet */
+	ktime_t burst_start;
+	unsigned int bursts;
+	unsigned int reached;
+	u64 latency_ns;
+	u64 max_latency_ns;
+	u64 residency_ns[SIM_NR_FREQS];
+	unsigned int msecs;
+} sim_replay = { .cpu = -1 };
+
+/* Called with sim_lock held */
+static void sim_account(struct sim_cpu *sc, ktime_t now)
+{
+	sc->residency_ns[sc->cur] +=
+		ktime_to_ns(ktime_sub(now, sc->last_change));
+	sc->last_change = now;
+}
+
+/* Called with sim_lock held, when the replay cpu runs at @index */
+static void sim_replay_freq(unsigned int index, ktime_t now)
+{
+	u64 latency;
+
+	if (!sim_replay.in_burst || index != SIM_NR_FREQS - 1)
+		return;
+
+	latency = ktime_to_ns(ktime_sub(now, sim_replay.burst_start));
+	sim_replay.in_burst = false;
+	sim_replay.reached++;
+	sim_replay.latency_ns += latency;
+	if (latency > sim_replay.max_latency_ns)
+		sim_replay.max_latency_ns = latency;
+}
+
+static int sim_cpufreq_verify(struct cpufreq_policy *policy)
+{
+	return cpufreq_frequency_table_verify(policy, sim_freq_table);
+}
+
+static int sim_cpufreq_target(struct cpufreq_policy *policy,
+			      unsigned int target_freq,
+			      unsigned int relation)
+{
+	struct sim_cpu *sc = &per_cpu(sim_cpus, policy->cpu);
+	struct cpufreq_freqs freqs;
+	unsigned int idx;
+	ktime_t now;
+
+	if (cpufreq_frequency_table_target(policy, sim_freq_table,
+					   target_freq, relation, &idx))
+		return -EINVAL;
+
+	freqs.old = sim_freq_table[sc->cur].frequency;
+	freqs.new = sim_freq_table[idx].frequency;
+	freqs.cpu = policy->cpu;
+
+	if (freqs.old == freqs.new)
+		return 0;
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+
+	/* The cpu keeps running at the old frequency meanwhile */
+	if (transition_us)
+		usleep_range(transition_us, transition_us);
+
+	spin_lock_irq(&sim_lock);
+	now = ktime_get();
+	sim_account(sc, now);
+	sc->cur = idx;
+	if (policy->cpu == sim_replay.cpu)
+		sim_replay_freq(idx, now);
+	spin_unlock_irq(&sim_lock);
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
+
+	return 0;
+}
+
+static unsigned int sim_cpufreq_get(unsigned int cpu)
+{
+	return sim_freq_table[per_cpu(sim_cpus, cpu).cur].frequency;
+}
+
+static int sim_cpufreq_init(struct cpufreq_policy *policy)
+{
+	struct sim_cpu *sc = &per_cpu(sim_cpus, policy->cpu);
+	int ret;
+
+	ret = cpufreq_frequency_table_cpuinfo(policy, sim_freq_table);
+	if (ret)
+		return ret;
+	cpufreq_frequency_table_get_attr(sim_freq_table, policy->cpu);
+
+	spin_lock_irq(&sim_lock);
+	memset(sc, 0, sizeof(*sc));
+	sc->last_change = ktime_get();
+	spin_unlock_irq(&sim_lock);
+
+	policy->cur = sim_freq_table[0].frequency;
+	policy->cpuinfo.transition_latency = transition_us * NSEC_PER_USEC;
+
+	return 0;
+}
+
+static int sim_cpufreq_exit(struct cpufreq_policy *policy)
+{
+	cpufreq_frequency_table_put_attr(policy->cpu);
+	return 0;
+}
+
+static struct freq_attr *sim_cpufreq_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	NULL,
+};
+
+static struct cpufreq_driver sim_cpufreq_driver = {
+	.verify	= sim_cpufreq_verify,
+	.target	= sim_cpufreq_target,
+	.get	= sim_cpufreq_get,
+	.init	= sim_cpufreq_init,
+	.exit	= sim_cpufreq_exit,
+	.name	= "sim",
+	.owner	= THIS_MODULE,
+	.attr	= sim_cpufreq_attr,
+};
+
+static void sim_burst_start(int cpu)
+{
+	spin_lock_irq(&sim_lock);
+	sim_replay.bursts++;
+	sim_replay.burst_start = ktime_get();
+	sim_replay.in_burst = true;
+	sim_replay_freq(per_cpu(sim_cpus, cpu).cur, sim_replay.burst_start);
+	spin_unlock_irq(&sim_lock);
+}
+
+static int sim_replay_thread(void *data)
+{
+	struct completion *done = data;
+	unsigned int i;
+	ktime_t end;
+
+	for (i = 0; i < sim_nr_bursts; i++) {
+		sim_burst_start(smp_processor_id());
+		end = ktime_add_us(ktime_get(), sim_trace[i].busy_us);
+		while (ktime_to_ns(ktime_sub(end, ktime_get())) > 0)
+			cond_resched();
+
+		spin_lock_irq(&sim_lock);
+		sim_replay.in_burst = false;
+		spin_unlock_irq(&sim_lock);
+
+		if (sim_trace[i].idle_us)
+			usleep_range(sim_trace[i].idle_us,
+				     sim_trace[i].idle_us);
+	}
+
+	complete(done);
+	return 0;
+}
+
+static int sim_replay_run(int cpu)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct task_struct *task;
+	struct sim_cpu *sc = &per_cpu(sim_cpus, cpu);
+	ktime_t start, now;
+	unsigned int i;
+
+	if (!sim_nr_bursts)
+		return -ENODATA;
+
+	task = kthread_create(sim_replay_thread, &done, "cpufreq_sim/%d", cpu);
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+	kthread_bind(task, cpu);
+
+	spin_lock_irq(&sim_lock);
+	memset(&sim_replay, 0, sizeof(sim_replay));
+	sim_replay.cpu = cpu;
+	sim_replay.running = true;
+	start = ktime_get();
+	sim_account(sc, start);
+	memcpy(sim_replay.residency_ns, sc->residency_ns,
+	       sizeof(sc->residency_ns));
+	spin_unlock_irq(&sim_lock);
+
+	wake_up_process(task);
+	wait_for_completion(&done);
+
+	spin_lock_irq(&sim_lock);
+	now = ktime_get();
+	sim_account(sc, now);
+	for (i = 0; i < SIM_NR_FREQS; i++)
+		sim_replay.residency_ns[i] = sc->residency_ns[i] -
+					     sim_replay.residency_ns[i];
+	sim_replay.msecs = ktime_to_ms(ktime_sub(now, start));
+	sim_replay.running = false;
+	spin_unlock_irq(&sim_lock);
+
+	return 0;
+}
+
+static int sim_trace_open(struct inode *inode, struct file *file)
+{
+	if (file->f_flags & O_TRUNC) {
+		mutex_lock(&sim_mutex);
+		sim_nr_bursts = 0;
+		mutex_unlock(&sim_mutex);
+	}
+	return 0;
+}
+
+/*
+ * Each line of the trace is a burst: "<busy_us> <idle_us>".
+ * Called with sim_mutex held.
+ */
+static int sim_trace_line(char *line, void *data)
+{
+	struct sim_burst *b;
+
+	if (sim_nr_bursts == SIM_MAX_BURSTS)
+		return -ENOSPC;
+	b = &sim_trace[sim_nr_bursts];
+	if (sscanf(line, "%u %u", &b->busy_us, &b->idle_us) != 2)
+		return -EINVAL;
+	sim_nr_bursts++;
+	return 0;
+}
+
+static ssize_t sim_trace_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&sim_mutex);
+	ret = simple_write_lines(ubuf, count, sim_trace_line, NULL);
+	mutex_unlock(&sim_mutex);
+	return ret;
+}
+
+static const struct file_operations sim_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sim_trace_open,
+	.write		= sim_trace_write,
+};
+
+static ssize_t sim_replay_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	char buf[16];
+	unsigned long cpu;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	ret = strict_strtoul(strstrip(buf), 0, &cpu);
+	if (ret)
+		return ret;
+
+	mutex_lock(&sim_mutex);
+	get_online_cpus();
+	if (cpu >= nr_cpu_ids || !cpu_online(cpu))
+		ret = -EINVAL;
+	else
+		ret = sim_replay_run(cpu);
+	put_online_cpus();
+	mutex_unlock(&sim_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations sim_replay_fops = {
+	.owner		= THIS_MODULE,
+	.write		= sim_replay_write,
+};
+
+static int sim_report_show(struct seq_file *m, void *v)
+{
+	u64 residency[SIM_NR_FREQS], total = 0;
+	unsigned int bursts, reached, msecs, i;
+	u64 latency, max_latency;
+	bool running;
+	int cpu;
+
+	spin_lock_irq(&sim_lock);
+	cpu = sim_replay.cpu;
+	bursts = sim_replay.bursts;
+	reached = sim_replay.reached;
+	latency = sim_replay.latency_ns;
+	max_latency = sim_replay.max_latency_ns;
+	msecs = sim_replay.msecs;
+	memcpy(residency, sim_replay.residency_ns, sizeof(residency));
+	running = sim_replay.running;
+	spin_unlock_irq(&sim_lock);
+
+	if (cpu < 0 || running) {
+		seq_printf(m, "no replay\n");
+		return 0;
+	}
+
+	seq_printf(m, "cpu %d: %u bursts in %u ms\n", cpu, bursts, msecs);
+	seq_printf(m, "latency to max: mean %llu us, max %llu us, "
+		   "%u bursts never reached it\n",
+		   reached ? div_u64(latency, reached * NSEC_PER_USEC) : 0,
+		   div_u64(max_latency, NSEC_PER_USEC), bursts - reached);
+
+	for (i = 0; i < SIM_NR_FREQS; i++)
+		total += residency[i];
+	seq_printf(m, "residency:\n");
+	for (i = 0; i < SIM_NR_FREQS; i++)
+		seq_printf(m, "%8u kHz %8llu ms %3llu%%\n",
+			   sim_freq_table[i].frequency,
+			   div_u64(residency[i], NSEC_PER_MSEC),
+			   total ? div64_u64(residency[i] * 100, total) : 0);
+	return 0;
+}
+
+static int sim_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_report_show, NULL);
+}
+
+static const struct file_operations sim_report_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sim_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *sim_dir;
+
+static int __init sim_cpufreq_module_init(void)
+{
+	int ret;
+
+	sim_dir = debugfs_create_dir("cpufreq_sim", NULL);
+	if (!sim_dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("trace", 0200, sim_dir, NULL,
+				 &sim_trace_fops) ||
+	    !debugfs_create_file("replay", 0200, sim_dir, NULL,
+				 &sim_replay_fops) ||
+	    !debugfs_create_file("report", 0400, sim_dir, NULL,
+				 &sim_report_fops)) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ret = cpufreq_register_driver(&sim_cpufreq_driver);
+	if (ret)
+		goto err;
+	return 0;
+
+err:
+	debugfs_remove_recursive(sim_dir);
+	return ret;
+}
+module_init(sim_cpufreq_module_init);
+
+static void __exit sim_cpufreq_module_exit(void)
+{
+	debugfs_remove_recursive(sim_dir);
+	cpufreq_unregister_driver(&sim_cpufreq_driver);
+}
+module_exit(sim_cpufreq_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Simulated cpufreq driver and governor replay harness");
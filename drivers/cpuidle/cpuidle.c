@@ -42,6 +42,36 @@ static void cpuidle_kick_cpus(void) {}
 
 static int __cpuidle_register_device(struct cpuidle_device *dev);
 
+/*
+ * Tell whether the governor picked the right state, going by how long
+ * the cpu actually stayed idle: too deep if it woke up before the state
+ * paid off, too shallow if it slept long enough for a deeper state.
+ */
+static void cpuidle_update_selection_stats(struct cpuidle_device *dev,
+					   struct cpuidle_state *target)
+{
+	int residency = dev->last_residency;
+	struct cpuidle_state *s;
+
+	if (!(target->flags & CPUIDLE_FLAG_TIME_VALID))
+		return;
+
+	if (residency < target->target_residency) {
+		target->too_deep++;
+		return;
+	}
+
+	/* The residency includes the time it took to wake up */
+	residency -= target->exit_latency;
+	for (s = target + 1; s < &dev->states[dev->state_count]; s++) {
+		if (s->flags & CPUIDLE_FLAG_IGNORE)
+			continue;
+		if (residency >= (int)s->target_residency)
+			target->too_shallow++;
+		break;
+	}
+}
+
 /**
  * cpuidle_idle_call - the main idle loop
  *
@@ -110,6 +140,7 @@ static void cpuidle_idle_call(void)
 
 	target_state->time += (unsigned long long)dev->last_residency;
 	target_state->usage++;
+	cpuidle_update_selection_stats(dev, target_state);
 
 	/* give the governor an opportunity to reflect on the outcome */
 	if (cpuidle_curr_governor->reflect)
@@ -236,6 +267,8 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states[i].usage = 0;
 		dev->states[i].time = 0;
+		dev->states[i].too_deep = 0;
+		dev->states[i].too_shallow = 0;
 	}
 	dev->last_residency = 0;
 	dev->last_state = NULL;
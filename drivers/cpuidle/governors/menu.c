@@ -25,7 +25,9 @@
 #define RESOLUTION 1024
 #define DECAY 8
 #define MAX_INTERESTING 50000
-#define STDDEV_THRESH 400
+#define STDDEV_THRESH 20
+#define HIST_DECAY_SHIFT 3
+#define HIST_MIN_WEIGHT (RESOLUTION * 4)
 
 
 /*
@@ -75,7 +77,21 @@
  * mice.
  * For this, we use a different predictor: We track the duration of the last 8
  * intervals and if the stand deviation of these 8 intervals is below a
- * threshold value, we use the average of these intervals as prediction.
+ * threshold value, or small next to their average, we use the average of
+ * these intervals as prediction.  Intervals well above the others, such as
+ * the odd long pause between bursts of audio or network interrupts, are
+ * left out one at a time as long as 6 of the 8 remain, so that a pattern
+ * still shows through them.
+ *
+ * Interval histogram
+ * ------------------
+ * Patterns that are not a single repeating interval, e.g. short wakeups
+ * from a touch controller mixed with longer ones from the next timer, fool
+ * both the above.  So we also keep, for each idle state, a decaying count
+ * of the recent idle intervals that were long enough for that state but
+ * not for the next deeper one.  If more than half the recent intervals
+ * were too short for the state picked, the deepest state that at least
+ * half of them were long enough for is used instead.
  *
  * Limiting Performance Impact
  * ---------------------------
@@ -119,6 +135,7 @@ struct menu_device {
 	u64		correction_factor[BUCKETS];
 	u32		intervals[INTERVALS];
 	int		interval_ptr;
+	unsigned int	hist[CPUIDLE_STATE_MAX];
 };
 
 
@@ -193,37 +210,107 @@ static u64 div_round64(u64 dividend, u32 divisor)
 /*
  * Try detecting repeating patterns by keeping track of the last 8
  * intervals, and checking if the standard deviation of that set
- * of points is below a threshold. If it is... then use the
- * average of these 8 points as the estimated value.
+ * of points is small, in itself or next to their average. If it is...
+ * then use the average of these points as the estimated value.
+ * Otherwise leave out the longest interval and try again. Either way
+ * a pattern needs at least 3/4 of the points.
  */
 static void detect_repeating_patterns(struct menu_device *data)
 {
-	int i;
-	uint64_t avg = 0;
-	uint64_t stddev = 0; /* contains the square of the std deviation */
+	unsigned long excluded = 0;	/* intervals left out, by index */
+	unsigned int max, divisor;
+	uint64_t avg, variance;
+	int64_t diff;
+	int i, max_i;
 
+again:
 	/* first calculate average and standard deviation of the past */
-	for (i = 0; i < INTERVALS; i++)
+	max = 0;
+	max_i = 0;
+	avg = 0;
+	divisor = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		if (excluded & (1UL << i))
+			continue;
 		avg += data->intervals[i];
-	avg = avg / INTERVALS;
-
-	/* if the avg is beyond the known next tick, it's worthless */
-	if (avg > data->expected_us)
-		return;
-
-	for (i = 0; i < INTERVALS; i++)
-		stddev += (data->intervals[i] - avg) *
-			  (data->intervals[i] - avg);
+		divisor++;
+		if (data->intervals[i] >= max) {
+			max = data->intervals[i];
+			max_i = i;
+		}
+	}
+	do_div(avg, divisor);
 
-	stddev = stddev / INTERVALS;
+	variance = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		if (excluded & (1UL << i))
+			continue;
+		diff = (int64_t)data->intervals[i] - (int64_t)avg;
+		variance += diff * diff;
+	}
+	do_div(variance, divisor);
 
 	/*
 	 * now.. if stddev is small.. then assume we have a
 	 * repeating pattern and predict we keep doing this.
+	 * The variance is checked against the squared thresholds, as
+	 * int_sqrt() only takes an unsigned long.
 	 */
+	if (divisor * 4 >= INTERVALS * 3 &&
+	    (variance <= STDDEV_THRESH * STDDEV_THRESH ||
+	     div_u64(avg * avg, 36) > variance)) {
+		/* if the avg is beyond the known next tick, it's worthless */
+		if (avg && avg <= data->expected_us)
+			data->predicted_us = avg;
+		return;
+	}
+
+	/* Only the one interval, even if others are as long */
+	if (divisor * 4 > INTERVALS * 3) {
+		excluded |= 1UL << max_i;
+		goto again;
+	}
+}
+
+/*
+ * The histogram bin of an idle interval: the deepest state it was long
+ * enough for.
+ */
+static int menu_hist_bin(struct cpuidle_device *dev, unsigned int us)
+{
+	int i;
 
-	if (avg && stddev < STDDEV_THRESH)
-		data->predicted_us = avg;
+	for (i = dev->state_count - 1; i > 0; i--)
+		if (dev->states[i].target_residency <= us)
+			break;
+	return i;
+}
+
+/*
+ * Step back from state @idx while more than half the recent idle
+ * intervals were too short for it.
+ */
+static int menu_check_histogram(struct cpuidle_device *dev,
+				struct menu_device *data, int idx)
+{
+	unsigned int total = 0, early = 0;
+	int i;
+
+	for (i = 0; i < dev->state_count; i++) {
+		total += data->hist[i];
+		if (i < idx)
+			early += data->hist[i];
+	}
+	if (total < HIST_MIN_WEIGHT)
+		return idx;
+
+	for (i = idx; i > CPUIDLE_DRIVER_STATE_START && early * 2 > total; ) {
+		i--;
+		early -= data->hist[i];
+		if (!(dev->states[i].flags & CPUIDLE_FLAG_IGNORE))
+			idx = i;
+	}
+	return idx;
 }
 
 /**
@@ -304,6 +391,12 @@ static int menu_select(struct cpuidle_device *dev)
 		}
 	}
 
+	i = menu_check_histogram(dev, data, data->last_state_idx);
+	if (i != data->last_state_idx) {
+		data->last_state_idx = i;
+		data->exit_us = dev->states[i].exit_latency;
+	}
+
 	return data->last_state_idx;
 }
 
@@ -332,6 +425,7 @@ static void menu_update(struct cpuidle_device *dev)
 	struct cpuidle_state *target = &dev->states[last_idx];
 	unsigned int measured_us;
 	u64 new_factor;
+	int i;
 
 	/*
 	 * Ugh, this idle state doesn't support residency measurements, so we
@@ -379,6 +473,13 @@ static void menu_update(struct cpuidle_device *dev)
 	data->intervals[data->interval_ptr++] = last_idle_us;
 	if (data->interval_ptr >= INTERVALS)
 		data->interval_ptr = 0;
+
+	/* and the histogram, if we know how long we really slept */
+	if (target->flags & CPUIDLE_FLAG_TIME_VALID) {
+		for (i = 0; i < dev->state_count; i++)
+			data->hist[i] -= data->hist[i] >> HIST_DECAY_SHIFT;
+		data->hist[menu_hist_bin(dev, measured_us)] += RESOLUTION;
+	}
 }
 
 /**
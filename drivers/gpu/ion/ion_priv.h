@@ -21,6 +21,7 @@
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/spinlock.h>
 #include <linux/ion.h>
 
 struct ion_mapping;
@@ -181,4 +182,30 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  */
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 
+/**
+ * struct ion_page_pool - pagepool struct
+ * @count:		number of chunks in the pool
+ * @items:		list of chunks, linked through page->lru
+ * @lock:		protects count and items
+ * @gfp_mask:		gfp_mask to use from alloc
+ * @order:		order of the chunks in the pool
+ *
+ * Allows you to keep a pool of zeroed chunks of one order around for faster
+ * allocations. Chunks are zeroed when they are returned to the pool, and
+ * given back to the buddy allocator by ion_page_pool_shrink.
+ */
+struct ion_page_pool {
+	int count;
+	struct list_head items;
+	spinlock_t lock;
+	gfp_t gfp_mask;
+	unsigned int order;
+};
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan);
+
 #endif /* _ION_PRIV_H */
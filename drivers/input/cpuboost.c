@@ -0,0 +1,147 @@
+/*
+ * drivers/input/cpuboost.c
+ *
+ * Asks cpufreq for a boost pulse as soon as a touchscreen or a keypad
+ * reports input, so that the frames drawn in response are not rendered
+ * at whatever low frequency the cpu idled at.  A pulse is sent once per
+ * input report, when the device closes it with EV_SYN.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+struct cpuboost_handle {
+	struct input_handle handle;
+	bool touch;		/* EV_ABS is touch, not e.g. a sensor */
+	bool pending;		/* a key press or touch since the last EV_SYN */
+};
+
+static void cpuboost_event(struct input_handle *handle, unsigned int type,
+			   unsigned int code, int value)
+{
+	struct cpuboost_handle *ch =
+		container_of(handle, struct cpuboost_handle, handle);
+
+	switch (type) {
+	case EV_KEY:
+		/* Releases and autorepeat are not worth a boost */
+		if (value == 1)
+			ch->pending = true;
+		break;
+	case EV_ABS:
+		if (ch->touch)
+			ch->pending = true;
+		break;
+	case EV_SYN:
+		if (code == SYN_REPORT && ch->pending) {
+			ch->pending = false;
+			cpufreq_boost_pulse();
+		}
+		break;
+	}
+}
+
+static int cpuboost_connect(struct input_handler *handler,
+			    struct input_dev *dev,
+			    const struct input_device_id *id)
+{
+	struct cpuboost_handle *ch;
+	int error;
+
+	ch = kzalloc(sizeof(*ch), GFP_KERNEL);
+	if (!ch)
+		return -ENOMEM;
+
+	ch->handle.dev = dev;
+	ch->handle.handler = handler;
+	ch->handle.name = "cpuboost";
+	ch->touch = id->driver_info;
+
+	error = input_register_handle(&ch->handle);
+	if (error)
+		goto err_free_handle;
+
+	error = input_open_device(&ch->handle);
+	if (error)
+		goto err_unregister_handle;
+
+	return 0;
+
+ err_unregister_handle:
+	input_unregister_handle(&ch->handle);
+ err_free_handle:
+	kfree(ch);
+	return error;
+}
+
+static void cpuboost_disconnect(struct input_handle *handle)
+{
+	struct cpuboost_handle *ch =
+		container_of(handle, struct cpuboost_handle, handle);
+
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(ch);
+}
+
+static const struct input_device_id cpuboost_ids[] = {
+	{
+		/* Multi-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+		.driver_info = 1,
+	},
+	{
+		/* Single-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+		.driver_info = 1,
+	},
+	{
+		/* Keypads and keyboards */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.driver_info = 0,
+	},
+	{ },	/* Terminating zero entry */
+};
+
+MODULE_DEVICE_TABLE(input, cpuboost_ids);
+
+static struct input_handler cpuboost_handler = {
+	.event =	cpuboost_event,
+	.connect =	cpuboost_connect,
+	.disconnect =	cpuboost_disconnect,
+	.name =		"cpuboost",
+	.id_table =	cpuboost_ids,
+};
+
+static int __init cpuboost_init(void)
+{
+	return input_register_handler(&cpuboost_handler);
+}
+
+static void __exit cpuboost_exit(void)
+{
+	input_unregister_handler(&cpuboost_handler);
+}
+
+module_init(cpuboost_init);
+module_exit(cpuboost_exit);
+
+MODULE_DESCRIPTION("cpufreq boost on touch and key input");
+MODULE_LICENSE("GPL");
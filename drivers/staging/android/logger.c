@@ -25,6 +25,8 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
@@ -33,17 +35,21 @@
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting.
+ *
+ * Positions (hdr->w_pos, hdr->head and each reader's r_pos) count bytes
+ * written since boot and wrap at 2^32; logger_offset() maps them into the
+ * buffer. Writers are serialized by 'lock'. Readers take no lock at all:
+ * a writer moves 'head' past the entries it is about to overwrite before
+ * touching them, so a reader that finds 'head' beyond where it started
+ * after copying knows the copy may be torn, and starts over from 'head'.
  */
 struct logger_log {
 	unsigned char 		*buffer;/* the ring buffer itself */
+	struct logger_mmap_hdr	*hdr;	/* write and head positions */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
-	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
-	size_t			w_off;	/* current write head offset */
-	size_t			head;	/* new readers start here */
+	spinlock_t		lock;	/* serializes writers */
 	size_t			size;	/* size of the log */
 };
 
@@ -51,17 +57,21 @@ struct logger_log {
  * struct logger_reader - a logging device open for reading
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. Only read() itself moves r_pos.
  */
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
-	struct list_head	list;	/* entry in logger_log's list */
-	size_t			r_off;	/* current read head offset */
+	struct mutex		mutex;	/* serializes reads on this file */
+	__u32			r_pos;	/* current read position */
+	int			batch;	/* read() may return several entries */
 };
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
+/* pos_before - is position a before b, allowing for wrap? */
+#define pos_before(a, b)	((__s32)((a) - (b)) < 0)
+
 /*
  * file_get_log - Given a file structure, return the associated log
  *
@@ -89,7 +99,8 @@ static inline struct logger_log *file_get_log(struct file *file)
  * get_entry_len - Grabs the length of the payload of the next entry starting
  * from 'off'.
  *
- * Caller needs to hold log->mutex.
+ * Without log->lock held the result may be garbage, and must be checked
+ * with log_lapped() before it is trusted.
  */
 static __u32 get_entry_len(struct logger_log *log, size_t off)
 {
@@ -108,16 +119,46 @@ static __u32 get_entry_len(struct logger_log *log, size_t off)
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * log_lapped - has a writer started overwriting data at or after 'pos'?
  *
- * Caller must hold log->mutex.
+ * Pairs with the smp_wmb() in logger_write_locked(): anything read from
+ * the buffer before this returns false was not being overwritten.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static inline int log_lapped(struct logger_log *log, __u32 pos)
+{
+	smp_rmb();
+	return pos_before(pos, ACCESS_ONCE(log->hdr->head));
+}
+
+/*
+ * reader_pos - where 'reader' should continue: its own position, unless
+ * the writer has lapped it or the log was flushed since.
+ */
+static __u32 reader_pos(struct logger_log *log, struct logger_reader *reader)
+{
+	__u32 head = ACCESS_ONCE(log->hdr->head);
+
+	if (pos_before(reader->r_pos, head))
+		return head;
+
+	return reader->r_pos;
+}
+
+/* logger_readable - is there anything past the reader's position? */
+static int logger_readable(struct logger_log *log,
+			   struct logger_reader *reader)
+{
+	return reader_pos(log, reader) != ACCESS_ONCE(log->hdr->w_pos);
+}
+
+/*
+ * do_read_log_to_user - copies 'count' bytes starting at position 'pos'
+ * of 'log' into the user-space buffer 'buf'.
+ */
+static int do_read_log_to_user(struct logger_log *log, __u32 pos,
+			       char __user *buf, size_t count)
 {
+	size_t off = logger_offset(pos);
 	size_t len;
 
 	/*
@@ -125,8 +166,8 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * the current read head offset up to 'count' bytes or to the end of
 	 * the log, whichever comes first.
 	 */
-	len = min(count, log->size - reader->r_off);
-	if (copy_to_user(buf, log->buffer + reader->r_off, len))
+	len = min(count, log->size - off);
+	if (copy_to_user(buf, log->buffer + off, len))
 		return -EFAULT;
 
 	/*
@@ -137,9 +178,65 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 		if (copy_to_user(buf + len, log->buffer, count - len))
 			return -EFAULT;
 
-	reader->r_off = logger_offset(reader->r_off + count);
+	return 0;
+}
+
+/*
+ * logger_read_entries - copies whole entries from the reader's position to
+ * 'buf': one, or as many as fit in batch mode. Returns the number of bytes
+ * copied, 0 if there is nothing to read, or -EINVAL if 'count' cannot hold
+ * the next entry.
+ */
+static ssize_t logger_read_entries(struct logger_log *log,
+				   struct logger_reader *reader,
+				   char __user *buf, size_t count)
+{
+	__u32 r, w, end;
+	size_t len;
+	int ret;
+
+retry:
+	w = ACCESS_ONCE(log->hdr->w_pos);
+	smp_rmb();
+	r = reader_pos(log, reader);
+
+	/* the head went past our w_pos: the log was flushed or lapped */
+	if (pos_before(w, r))
+		goto retry;
+
+	for (end = r; end != w; end += len) {
+		if (end != r && !reader->batch)
+			break;
+		len = get_entry_len(log, logger_offset(end));
+		if (len > LOGGER_ENTRY_MAX_LEN || w - end < len) {
+			/* torn length; only possible if we were lapped */
+			if (log_lapped(log, r))
+				goto retry;
+			break;
+		}
+		if (end - r + len > count)
+			break;
+	}
+
+	if (end == r) {
+		if (r == w)
+			return 0;
+		if (log_lapped(log, r))
+			goto retry;
+		return -EINVAL;
+	}
+
+	ret = do_read_log_to_user(log, r, buf, end - r);
+	if (ret)
+		return ret;
+
+	/* the entries were overwritten while we copied them */
+	if (log_lapped(log, r))
+		goto retry;
+
+	reader->r_pos = end;
 
-	return count;
+	return end - r;
 }
 
 /*
@@ -149,10 +246,14 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
  *
  * 	- O_NONBLOCK works
  * 	- If there are no log entries to read, blocks until log is written to
- * 	- Atomically reads exactly one log entry
+ * 	- Atomically reads exactly one log entry, or in batch mode
+ * 	  (LOGGER_SET_BATCH_READ) as many whole entries as fit in 'count'
  *
  * Optimal read size is LOGGER_ENTRY_MAX_LEN. Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
+ *
+ * Readers never take the log's lock, so a slow reader cannot hold up
+ * writers.
  */
 static ssize_t logger_read(struct file *file, char __user *buf,
 			   size_t count, loff_t *pos)
@@ -160,175 +261,160 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
 	ssize_t ret;
-	DEFINE_WAIT(wait);
 
-start:
+	mutex_lock(&reader->mutex);
 	while (1) {
-		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
-
-		mutex_lock(&log->mutex);
-		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
-		if (!ret)
-			break;
-
-		if (file->f_flags & O_NONBLOCK) {
-			ret = -EAGAIN;
-			break;
+		if (!logger_readable(log, reader)) {
+			if (file->f_flags & O_NONBLOCK) {
+				ret = -EAGAIN;
+				break;
+			}
+
+			ret = wait_event_interruptible(log->wq,
+					logger_readable(log, reader));
+			if (ret)
+				break;
 		}
 
-		if (signal_pending(current)) {
-			ret = -EINTR;
+		/* zero if a flush emptied the log meanwhile */
+		ret = logger_read_entries(log, reader, buf, count);
+		if (ret)
 			break;
-		}
-
-		schedule();
-	}
-
-	finish_wait(&log->wq, &wait);
-	if (ret)
-		return ret;
-
-	mutex_lock(&log->mutex);
-
-	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
-		goto start;
-	}
-
-	/* get the size of the next entry */
-	ret = get_entry_len(log, reader->r_off);
-	if (count < ret) {
-		ret = -EINVAL;
-		goto out;
 	}
-
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
-
-out:
-	mutex_unlock(&log->mutex);
+	mutex_unlock(&reader->mutex);
 
 	return ret;
 }
 
 /*
- * get_next_entry - return the offset of the first valid entry at least 'len'
- * bytes after 'off'.
+ * fix_up_head - pull the head forward to the first entry that survives a
+ * write of 'len' bytes at position 'w'. Readers behind the new head were
+ * lapped; they notice by themselves and skip forward to it.
  *
- * Caller must hold log->mutex.
+ * The caller needs to hold log->lock.
  */
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
+static void fix_up_head(struct logger_log *log, __u32 w, size_t len)
 {
-	size_t count = 0;
+	__u32 head = log->hdr->head;
 
-	do {
-		size_t nr = get_entry_len(log, off);
-		off = logger_offset(off + nr);
-		count += nr;
-	} while (count < len);
+	while (pos_before(head, w + len - log->size))
+		head += get_entry_len(log, logger_offset(head));
 
-	return off;
+	log->hdr->head = head;
 }
 
 /*
- * clock_interval - is a < c < b in mod-space? Put another way, does the line
- * from a to b cross c?
+ * do_write_log - writes 'count' bytes from 'buf' at position 'pos' of 'log'
+ *
+ * The caller needs to hold log->lock.
  */
-static inline int clock_interval(size_t a, size_t b, size_t c)
+static void do_write_log(struct logger_log *log, __u32 pos, const void *buf,
+			 size_t count)
 {
-	if (b < a) {
-		if (a < c || b >= c)
-			return 1;
-	} else {
-		if (a < c && b >= c)
-			return 1;
-	}
+	size_t off = logger_offset(pos);
+	size_t len;
 
-	return 0;
+	len = min(count, log->size - off);
+	memcpy(log->buffer + off, buf, len);
+
+	if (count != len)
+		memcpy(log->buffer, buf + len, count - len);
 }
 
 /*
- * fix_up_readers - walk the list of all readers and "fix up" any who were
- * lapped by the writer; also do the same for the default "start head".
- * We do this by "pulling forward" the readers and start head to the first
- * entry after the new write head.
- *
- * The caller needs to hold log->mutex.
+ * Payloads are gathered here from user space before the log is touched.
+ * Only used under a log's spinlock, so with preemption off.
  */
-static void fix_up_readers(struct logger_log *log, size_t len)
-{
-	size_t old = log->w_off;
-	size_t new = logger_offset(old + len);
-	struct logger_reader *reader;
-
-	if (clock_interval(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
-
-	list_for_each_entry(reader, &log->readers, list)
-		if (clock_interval(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
-}
+static DEFINE_PER_CPU(char [LOGGER_ENTRY_MAX_PAYLOAD], logger_scratch);
 
 /*
- * do_write_log - writes 'len' bytes from 'buf' to 'log'
+ * copy_payload_inatomic - gathers 'count' bytes from the user-space vectors
+ * into 'buf'. Page faults are disabled, as we hold a spinlock: this fails
+ * if the user buffer is not resident.
  *
- * The caller needs to hold log->mutex.
+ * Returns 0 on success, -EFAULT on failure.
  */
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
+static int copy_payload_inatomic(char *buf, const struct iovec *iov,
+				 unsigned long nr_segs, size_t count)
 {
-	size_t len;
+	unsigned long left = 0;
 
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
+	pagefault_disable();
+	while (nr_segs-- > 0 && count) {
+		/* figure out how much of this vector we can keep */
+		size_t len = min_t(size_t, iov->iov_len, count);
 
-	if (count != len)
-		memcpy(log->buffer, buf + len, count - len);
+		left = __copy_from_user_inatomic(buf, iov->iov_base, len);
+		if (left)
+			break;
 
-	log->w_off = logger_offset(log->w_off + count);
+		iov++;
+		buf += len;
+		count -= len;
+	}
+	pagefault_enable();
 
+	return left ? -EFAULT : 0;
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
+ * logger_write_locked - appends one entry, its payload taken from 'payload'
+ * if given, else from the user-space vectors. The payload is copied in
+ * full before the head moves, so a fault leaves the log untouched.
  *
- * Returns 'count' on success, negative error code on failure.
+ * The caller needs to hold log->lock.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static int logger_write_locked(struct logger_log *log,
+			       struct logger_entry *header,
+			       const void *payload,
+			       const struct iovec *iov, unsigned long nr_segs)
 {
-	size_t len;
+	__u32 w = log->hdr->w_pos;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	if (!payload) {
+		char *buf = __get_cpu_var(logger_scratch);
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
+		if (copy_payload_inatomic(buf, iov, nr_segs, header->len))
 			return -EFAULT;
+		payload = buf;
+	}
+
+	/*
+	 * Move the head past what we are about to overwrite, and make that
+	 * visible before the first byte of it changes.
+	 */
+	fix_up_head(log, w, sizeof(struct logger_entry) + header->len);
+	smp_wmb();
+
+	do_write_log(log, w, header, sizeof(struct logger_entry));
+	do_write_log(log, w + sizeof(struct logger_entry), payload,
+		     header->len);
 
-	log->w_off = logger_offset(log->w_off + count);
+	/* the entry must be complete before readers can see it */
+	smp_wmb();
+	log->hdr->w_pos = w + sizeof(struct logger_entry) + header->len;
 
-	return count;
+	return 0;
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The payload is copied from user space into a per-cpu buffer under the
+ * log's spinlock with page faults disabled. If that faults, it is copied
+ * into a kmalloc'ed buffer outside the lock and written from there.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
+	char *payload, *p;
+	size_t left;
+	int ret;
 
 	now = current_kernel_time();
 
@@ -342,43 +428,36 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
+	spin_lock(&log->lock);
+	ret = logger_write_locked(log, &header, NULL, iov, nr_segs);
+	spin_unlock(&log->lock);
 
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	if (unlikely(ret)) {
+		payload = kmalloc(header.len, GFP_KERNEL);
+		if (!payload)
+			return -ENOMEM;
 
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
+		for (p = payload, left = header.len; left; iov++) {
+			size_t len = min_t(size_t, iov->iov_len, left);
 
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+			if (copy_from_user(p, iov->iov_base, len)) {
+				kfree(payload);
+				return -EFAULT;
+			}
+			p += len;
+			left -= len;
 		}
 
-		iov++;
-		ret += nr;
+		spin_lock(&log->lock);
+		logger_write_locked(log, &header, payload, NULL, 0);
+		spin_unlock(&log->lock);
+		kfree(payload);
 	}
 
-	mutex_unlock(&log->mutex);
-
 	/* wake up any blocked readers */
 	wake_up_interruptible(&log->wq);
 
-	return ret;
+	return header.len;
 }
 
 static struct logger_log *get_log_from_minor(int);
@@ -409,12 +488,9 @@ static int logger_open(struct inode *inode, struct file *file)
 			return -ENOMEM;
 
 		reader->log = log;
-		INIT_LIST_HEAD(&reader->list);
-
-		mutex_lock(&log->mutex);
-		reader->r_off = log->head;
-		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		mutex_init(&reader->mutex);
+		reader->r_pos = ACCESS_ONCE(log->hdr->head);
+		reader->batch = 0;
 
 		file->private_data = reader;
 	} else
@@ -432,7 +508,6 @@ static int logger_release(struct inode *ignored, struct file *file)
 {
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader = file->private_data;
-		list_del(&reader->list);
 		kfree(reader);
 	}
 
@@ -445,8 +520,8 @@ static int logger_release(struct inode *ignored, struct file *file)
  * Note we always return POLLOUT, because you can always write() to the log.
  * Note also that, strictly speaking, a return value of POLLIN does not
  * guarantee that the log is readable without blocking, as there is a small
- * chance that the writer can lap the reader in the interim between poll()
- * returning and the read() request.
+ * chance that the log is flushed in the interim between poll() returning
+ * and the read() request.
  */
 static unsigned int logger_poll(struct file *file, poll_table *wait)
 {
@@ -462,10 +537,8 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
-	if (log->w_off != reader->r_off)
+	if (logger_readable(log, reader))
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
 
 	return ret;
 }
@@ -474,10 +547,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	__u32 pos;
 	long ret = -ENOTTY;
 
-	mutex_lock(&log->mutex);
-
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
 		ret = log->size;
@@ -488,10 +560,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		pos = reader_pos(log, reader);
+		ret = ACCESS_ONCE(log->hdr->w_pos) - pos;
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -499,28 +569,71 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off != reader->r_off)
-			ret = get_entry_len(log, reader->r_off);
-		else
-			ret = 0;
+		do {
+			pos = reader_pos(log, reader);
+			if (pos != ACCESS_ONCE(log->hdr->w_pos))
+				ret = get_entry_len(log, logger_offset(pos));
+			else
+				ret = 0;
+		} while (log_lapped(log, pos));
 		break;
 	case LOGGER_FLUSH_LOG:
 		if (!(file->f_mode & FMODE_WRITE)) {
 			ret = -EBADF;
 			break;
 		}
-		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+		/* readers behind the head skip forward by themselves */
+		spin_lock(&log->lock);
+		log->hdr->head = log->hdr->w_pos;
+		spin_unlock(&log->lock);
+		ret = 0;
+		break;
+	case LOGGER_SET_BATCH_READ:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		mutex_lock(&reader->mutex);
+		reader->batch = !!arg;
+		mutex_unlock(&reader->mutex);
 		ret = 0;
 		break;
 	}
 
-	mutex_unlock(&log->mutex);
-
 	return ret;
 }
 
+/*
+ * logger_mmap - maps the log read-only: the struct logger_mmap_hdr page,
+ * followed by the ring buffer itself. See logger.h for how to consume it.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_log *log = file_get_log(file);
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EACCES;
+
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE + log->size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(log->hdr) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	return remap_pfn_range(vma, vma->vm_start + PAGE_SIZE,
+			       virt_to_phys(log->buffer) >> PAGE_SHIFT,
+			       log->size, vma->vm_page_prot);
+}
+
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
@@ -528,6 +641,7 @@ static const struct file_operations logger_fops = {
 	.poll = logger_poll,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
+	.mmap = logger_mmap,
 	.open = logger_open,
 	.release = logger_release,
 };
@@ -538,7 +652,7 @@ static const struct file_operations logger_fops = {
  * LONG_MAX minus LOGGER_ENTRY_MAX_LEN.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(PAGE_SIZE); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -548,10 +662,7 @@ static struct logger_log VAR = { \
 		.parent = NULL, \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
-	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
-	.w_off = 0, \
-	.head = 0, \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.size = SIZE, \
 };
 
@@ -577,10 +688,18 @@ static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	/* page aligned, so that it can be mapped on its own */
+	log->hdr = (struct logger_mmap_hdr *)get_zeroed_page(GFP_KERNEL);
+	if (unlikely(!log->hdr))
+		return -ENOMEM;
+	SetPageReserved(virt_to_page(log->hdr));
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
 		       "device for log '%s'!\n", log->misc.name);
+		ClearPageReserved(virt_to_page(log->hdr));
+		free_page((unsigned long)log->hdr);
 		return ret;
 	}
 
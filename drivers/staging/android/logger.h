@@ -30,6 +30,25 @@ struct logger_entry {
 	char		msg[0];	/* the entry's payload */
 };
 
+/*
+ * A log can be mapped read-only with mmap(): at offset 0 one page holding
+ * struct logger_mmap_hdr, followed by the ring buffer itself, whose size
+ * LOGGER_GET_LOG_BUF_SIZE returns. Positions count bytes written and wrap
+ * at 2^32; the entry at position 'pos' starts at byte (pos & (size - 1))
+ * of the ring, and may wrap around its end. The entries from 'head' up to
+ * 'w_pos' are valid.
+ *
+ * To consume entries in place, read w_pos, issue a read barrier, process
+ * the entries from your position up to w_pos, issue another read barrier
+ * and read head. If head has moved past where you started, the writer
+ * lapped you while you were reading; drop what you read and continue
+ * from head. Use poll() on the file to wait for new entries.
+ */
+struct logger_mmap_hdr {
+	__u32		w_pos;	/* end of the last complete entry */
+	__u32		head;	/* start of the oldest entry */
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -45,5 +64,6 @@ struct logger_entry {
 #define LOGGER_GET_LOG_LEN		_IO(__LOGGERIO, 2) /* used log len */
 #define LOGGER_GET_NEXT_ENTRY_LEN	_IO(__LOGGERIO, 3) /* next entry len */
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
+#define LOGGER_SET_BATCH_READ		_IO(__LOGGERIO, 5) /* read many entries */
 
 #endif /* _LINUX_LOGGER_H */
@@ -16,6 +16,10 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * With CONFIG_ANDROID_LMK_ADJ_RBTREE, processes are kept in a tree ordered
+ * by oom_adj, so only those with the highest oom_adj are looked at when
+ * picking one to kill.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -35,6 +39,12 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include "trace/lowmemorykiller.h"
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -79,16 +89,217 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	return NOTIFY_OK;
 }
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+/*
+ * Thread group leaders ordered by oom_adj, equal values in insertion
+ * order. Nodes are added and removed with the tasks list, under
+ * tasklist_lock, and moved by /proc/<pid>/oom_adj and oom_score_adj
+ * writes. Each task caches the key it was inserted under, so an
+ * oom_adj change that has not been reindexed yet leaves the tree
+ * consistent.
+ *
+ * fork and exit take lowmem_adj_lock under siglock, which nests inside
+ * task_lock and is taken with interrupts off. Every other user must
+ * disable interrupts too, and task_lock may only be trylocked under
+ * lowmem_adj_lock; a task whose lock is busy is skipped.
+ */
+static struct rb_root lowmem_adj_tree = RB_ROOT;
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+
+static void __lowmem_adj_insert(struct task_struct *p)
+{
+	struct rb_node **link = &lowmem_adj_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct task_struct *entry;
+
+	p->lowmem_adj = p->signal->oom_adj;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct task_struct, lowmem_adj_node);
+		if (p->lowmem_adj < entry->lowmem_adj)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&p->lowmem_adj_node, parent, link);
+	rb_insert_color(&p->lowmem_adj_node, &lowmem_adj_tree);
+}
+
+void lowmem_adj_insert(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	__lowmem_adj_insert(p);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+void lowmem_adj_remove(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!RB_EMPTY_NODE(&p->lowmem_adj_node)) {
+		rb_erase(&p->lowmem_adj_node, &lowmem_adj_tree);
+		RB_CLEAR_NODE(&p->lowmem_adj_node);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* exec() made new the leader of old's thread group */
+void lowmem_adj_replace(struct task_struct *old, struct task_struct *new)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!RB_EMPTY_NODE(&old->lowmem_adj_node)) {
+		new->lowmem_adj = old->lowmem_adj;
+		rb_replace_node(&old->lowmem_adj_node, &new->lowmem_adj_node,
+				&lowmem_adj_tree);
+		RB_CLEAR_NODE(&old->lowmem_adj_node);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* p's oom_adj may have changed; move its thread group to match */
+void lowmem_adj_update(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	p = p->group_leader;
+	if (!RB_EMPTY_NODE(&p->lowmem_adj_node) &&
+	    p->lowmem_adj != p->signal->oom_adj) {
+		rb_erase(&p->lowmem_adj_node, &lowmem_adj_tree);
+		__lowmem_adj_insert(p);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/*
+ * Walk down from the highest oom_adj. The first level holding a task
+ * with memory decides: the largest task on it is selected, and no
+ * lower level needs to be looked at.
+ */
+static struct task_struct *lowmem_select(int min_adj, int *oom_adj,
+					 int *tasksize, int *nr_scanned)
+{
+	struct rb_node *n;
+	struct task_struct *selected;
+	int selected_tasksize;
+	int selected_oom_adj;
+	unsigned long flags;
+
+	selected = NULL;
+	selected_tasksize = 0;
+	selected_oom_adj = min_adj;
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	for (n = rb_last(&lowmem_adj_tree); n; n = rb_prev(n)) {
+		struct task_struct *p;
+		struct mm_struct *mm;
+		int size;
+
+		p = rb_entry(n, struct task_struct, lowmem_adj_node);
+		if (p->lowmem_adj < min_adj)
+			break;
+		if (selected && p->lowmem_adj < selected_oom_adj)
+			break;
+		(*nr_scanned)++;
+
+		/* Busy; a task we cannot look at now is not a candidate */
+		if (!spin_trylock(&p->alloc_lock))
+			continue;
+		mm = p->mm;
+		if (!mm) {
+			task_unlock(p);
+			continue;
+		}
+		size = get_mm_rss(mm);
+		task_unlock(p);
+		if (size <= 0)
+			continue;
+		if (selected && size <= selected_tasksize)
+			continue;
+		selected = p;
+		selected_tasksize = size;
+		selected_oom_adj = p->lowmem_adj;
+		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+			     p->pid, p->comm, selected_oom_adj, size);
+	}
+	if (selected)
+		get_task_struct(selected);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+
+	*oom_adj = selected_oom_adj;
+	*tasksize = selected_tasksize;
+	return selected;
+}
+#else
+static struct task_struct *lowmem_select(int min_adj, int *oom_adj,
+					 int *tasksize, int *nr_scanned)
 {
 	struct task_struct *p;
 	struct task_struct *selected = NULL;
+	int selected_tasksize = 0;
+	int selected_oom_adj = min_adj;
+
+	read_lock(&tasklist_lock);
+	for_each_process(p) {
+		struct mm_struct *mm;
+		struct signal_struct *sig;
+		int oom_adj;
+		int size;
+
+		(*nr_scanned)++;
+		task_lock(p);
+		mm = p->mm;
+		sig = p->signal;
+		if (!mm || !sig) {
+			task_unlock(p);
+			continue;
+		}
+		oom_adj = sig->oom_adj;
+		if (oom_adj < min_adj) {
+			task_unlock(p);
+			continue;
+		}
+		size = get_mm_rss(mm);
+		task_unlock(p);
+		if (size <= 0)
+			continue;
+		if (selected) {
+			if (oom_adj < selected_oom_adj)
+				continue;
+			if (oom_adj == selected_oom_adj &&
+			    size <= selected_tasksize)
+				continue;
+		}
+		selected = p;
+		selected_tasksize = size;
+		selected_oom_adj = oom_adj;
+		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+			     p->pid, p->comm, oom_adj, size);
+	}
+	if (selected)
+		get_task_struct(selected);
+	read_unlock(&tasklist_lock);
+
+	*oom_adj = selected_oom_adj;
+	*tasksize = selected_tasksize;
+	return selected;
+}
+#endif
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *selected;
 	int rem = 0;
-	int tasksize;
 	int i;
 	int min_adj = OOM_ADJUST_MAX + 1;
-	int selected_tasksize = 0;
+	int selected_tasksize;
 	int selected_oom_adj;
+	int nr_scanned = 0;
+	ktime_t start;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES);
 	int other_file = global_page_state(NR_FILE_PAGES) -
@@ -129,55 +340,28 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_adj = min_adj;
 
-	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
+	start = ktime_get();
+	selected = lowmem_select(min_adj, &selected_oom_adj,
+				 &selected_tasksize, &nr_scanned);
+	trace_lowmemory_select(min_adj, nr_scanned,
+			       selected ? selected->pid : 0,
+			       ktime_to_ns(ktime_sub(ktime_get(), start)));
 
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
-				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
-	}
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
 			     selected_oom_adj, selected_tasksize);
+		trace_lowmemory_kill(selected, selected_oom_adj,
+				     selected_tasksize, other_free, other_file);
 		lowmem_deathpending = selected;
 		lowmem_deathpending_timeout = jiffies + HZ;
-		force_sig(SIGKILL, selected);
+		send_sig(SIGKILL, selected, 0);
+		put_task_struct(selected);
 		rem -= selected_tasksize;
 	}
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
@@ -0,0 +1,75 @@
+#undef TRACE_SYSTEM
+#define TRACE_INCLUDE_PATH ../../drivers/staging/android/trace
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(lowmemory_select,
+
+	TP_PROTO(int min_adj, int nr_scanned, pid_t pid, s64 latency_ns),
+
+	TP_ARGS(min_adj, nr_scanned, pid, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(int, min_adj)
+		__field(int, nr_scanned)
+		__field(pid_t, pid)
+		__field(s64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->min_adj = min_adj;
+		__entry->nr_scanned = nr_scanned;
+		__entry->pid = pid;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("min_adj=%d nr_scanned=%d pid=%d latency_ns=%lld",
+		__entry->min_adj,
+		__entry->nr_scanned,
+		__entry->pid,
+		__entry->latency_ns)
+);
+
+TRACE_EVENT(lowmemory_kill,
+
+	TP_PROTO(struct task_struct *killed_task, int oom_adj, int tasksize,
+		int other_free, int other_file),
+
+	TP_ARGS(killed_task, oom_adj, tasksize, other_free, other_file),
+
+	TP_STRUCT__entry(
+		__array(char, comm, TASK_COMM_LEN)
+		__field(pid_t, pid)
+		__field(int, oom_adj)
+		__field(int, tasksize)
+		__field(int, other_free)
+		__field(int, other_file)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, killed_task->comm, TASK_COMM_LEN);
+		__entry->pid = killed_task->pid;
+		__entry->oom_adj = oom_adj;
+		__entry->tasksize = tasksize;
+		__entry->other_free = other_free;
+		__entry->other_file = other_file;
+	),
+
+	TP_printk("%s pid=%d oom_adj=%d size=%d free=%d file=%d",
+		__entry->comm,
+		__entry->pid,
+		__entry->oom_adj,
+		__entry->tasksize,
+		__entry->other_free,
+		__entry->other_file)
+);
+
+#endif /* _TRACE_LOWMEMORYKILLER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -28,10 +28,12 @@
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
+#include <linux/ktime.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
@@ -42,6 +44,13 @@ struct zram *devices;
 /* Module params (documentation at end) */
 unsigned int num_devices;
 
+/* Crypto API names of the backends */
+const char *const zram_backend_names[__NR_ZRAM_BACKENDS] = {
+	[ZRAM_BACKEND_LZO]	= "lzo",
+	[ZRAM_BACKEND_DEFLATE]	= "deflate",
+	[ZRAM_BACKEND_LZ4]	= "lz4",
+};
+
 static void zram_stat_inc(u32 *v)
 {
 	*v = *v + 1;
@@ -71,6 +80,31 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+static void zram_backend_stat_compress(struct zram *zram, unsigned int clen,
+				s64 ns)
+{
+	struct zram_backend_stats *bstats =
+				&zram->backend_stats[zram->backend];
+
+	spin_lock(&zram->stat64_lock);
+	bstats->pages_compressed++;
+	bstats->orig_size += PAGE_SIZE;
+	bstats->compr_size += clen;
+	bstats->compress_ns += ns;
+	spin_unlock(&zram->stat64_lock);
+}
+
+static void zram_backend_stat_decompress(struct zram *zram, s64 ns)
+{
+	struct zram_backend_stats *bstats =
+				&zram->backend_stats[zram->backend];
+
+	spin_lock(&zram->stat64_lock);
+	bstats->pages_decompressed++;
+	bstats->decompress_ns += ns;
+	spin_unlock(&zram->stat64_lock);
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
@@ -89,21 +123,153 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 0; pos != PAGE_SIZE / sizeof(*page) - 1; pos++) {
+		if (page[pos] != page[pos + 1])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+/*
+ * Look for a stored object with the same compressed bytes and take
+ * a reference to it. Objects with the same checksum sit next to each
+ * other in the tree, from the leftmost one on, and each is compared
+ * in turn. The tree lock keeps the candidates alive meanwhile.
+ */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+				void *src, unsigned int clen, u32 checksum)
+{
+	struct rb_node *node, *first = NULL;
+	struct zram_dedup_entry *entry;
+
+	spin_lock(&zram->dedup_lock);
+	node = zram->dedup_tree.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, node);
+		if (checksum < entry->checksum)
+			node = node->rb_left;
+		else if (checksum > entry->checksum)
+			node = node->rb_right;
+		else {
+			first = node;
+			node = node->rb_left;
+		}
+	}
+
+	for (node = first; node; node = rb_next(node)) {
+		unsigned char *cmem;
+		int match;
+
+		entry = rb_entry(node, struct zram_dedup_entry, node);
+		if (entry->checksum != checksum)
+			break;
+		if (entry->clen != clen)
+			continue;
+
+		cmem = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(cmem, src, clen);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&zram->dedup_lock);
+			return entry;
+		}
+	}
+	spin_unlock(&zram->dedup_lock);
+
+	return NULL;
+}
+
+static void zram_dedup_insert(struct zram *zram,
+				struct zram_dedup_entry *new)
+{
+	struct rb_node **link = &zram->dedup_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct zram_dedup_entry *entry;
+
+	spin_lock(&zram->dedup_lock);
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct zram_dedup_entry, node);
+		if (new->checksum < entry->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&new->node, parent, link);
+	rb_insert_color(&new->node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+}
+
+static void zram_stream_free(struct zram_stream *zstrm)
+{
+	if (!IS_ERR_OR_NULL(zstrm->tfm))
+		crypto_free_comp(zstrm->tfm);
+	free_pages((unsigned long)zstrm->buffer, 1);
+	kfree(zstrm);
+}
+
+static struct zram_stream *zram_stream_alloc(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+
+	zstrm = kzalloc(sizeof(*zstrm), GFP_KERNEL);
+	if (!zstrm)
+		return NULL;
+
+	zstrm->tfm = crypto_alloc_comp(zram_backend_names[zram->backend],
+					0, 0);
+	zstrm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (IS_ERR(zstrm->tfm) || !zstrm->buffer) {
+		zram_stream_free(zstrm);
+		return NULL;
+	}
+
+	return zstrm;
+}
+
+/*
+ * Take an idle stream, sleeping until one is released if all
+ * of them are busy.
+ */
+static struct zram_stream *zram_stream_get(struct zram *zram)
+{
+	struct zram_stream *zstrm;
+
+	spin_lock(&zram->stream_lock);
+	while (list_empty(&zram->idle_streams)) {
+		spin_unlock(&zram->stream_lock);
+		wait_event(zram->stream_wait,
+			!list_empty(&zram->idle_streams));
+		spin_lock(&zram->stream_lock);
+	}
+	zstrm = list_first_entry(&zram->idle_streams,
+				struct zram_stream, list);
+	list_del(&zstrm->list);
+	spin_unlock(&zram->stream_lock);
+
+	return zstrm;
+}
+
+static void zram_stream_put(struct zram *zram, struct zram_stream *zstrm)
+{
+	spin_lock(&zram->stream_lock);
+	list_add(&zstrm->list, &zram->idle_streams);
+	spin_unlock(&zram->stream_lock);
+
+	wake_up(&zram->stream_wait);
+}
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -133,56 +299,147 @@ static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 	zram->disksize &= PAGE_MASK;
 }
 
-static void zram_free_page(struct zram *zram, size_t index)
+/* Free a compressed object along with its share of the stats */
+static void zram_free_obj(struct zram *zram, unsigned long handle, u32 clen)
+{
+	zs_free(zram->mem_pool, handle);
+	if (clen <= PAGE_SIZE / 2)
+		zram_stat_dec(&zram->stats.good_compress);
+
+	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
+}
+
+static void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
 {
-	u32 clen;
-	void *obj;
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		zram_stat_dec(&zram->stats.pages_dup);
+		zram_stat64_sub(zram, &zram->stats.dup_size, entry->clen);
+		return;
+	}
+	rb_erase(&entry->node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	zram_free_obj(zram, entry->handle, entry->clen);
+	kfree(entry);
+}
+
+/*
+ * Claim a free block on the backing device. Returns 0, never a valid
+ * block, once the device is full.
+ */
+static unsigned long zram_alloc_block(struct zram *zram)
+{
+	unsigned long blk;
+
+retry:
+	blk = find_next_zero_bit(zram->bitmap, zram->nr_blocks, 1);
+	if (blk == zram->nr_blocks)
+		return 0;
 
-	struct page *page = zram->table[index].page;
-	u32 offset = zram->table[index].offset;
+	if (test_and_set_bit(blk, zram->bitmap))
+		goto retry;
+
+	return blk;
+}
+
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+	WARN_ON(!test_and_clear_bit(blk, zram->bitmap));
+}
+
+/*
+ * Drop a table entry's reference to a backing device block. Called
+ * with table_lock held for write.
+ */
+static void zram_put_block(struct zram *zram, unsigned long blk)
+{
+	if (atomic_read(&zram->wb_reads)) {
+		set_bit(blk, zram->free_pending);
+		zram->nr_free_pending++;
+	} else
+		zram_free_block(zram, blk);
+}
 
-	if (unlikely(!page)) {
+/* A read from the backing device is done; release deferred frees */
+static void zram_wb_read_done(struct zram *zram)
+{
+	unsigned long blk;
+
+	write_lock(&zram->table_lock);
+	if (atomic_dec_and_test(&zram->wb_reads) && zram->nr_free_pending) {
+		for_each_set_bit(blk, zram->free_pending, zram->nr_blocks)
+			zram_free_block(zram, blk);
+		bitmap_zero(zram->free_pending, zram->nr_blocks);
+		zram->nr_free_pending = 0;
+	}
+	write_unlock(&zram->table_lock);
+}
+
+static void zram_free_page(struct zram *zram, size_t index)
+{
+	unsigned long handle = zram->table[index].handle;
+
+	/* Whatever the slot held, it is being replaced or dropped */
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_put_block(zram, zram->table[index].element);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram->table[index].element = 0;
+		zram_stat_dec(&zram->stats.pages_wb);
+		zram_stat_dec(&zram->stats.pages_stored);
+		return;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
 		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
+		 * No memory is allocated for same filled pages.
+		 * Simply clear the flag.
 		 */
-		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-			zram_clear_flag(zram, index, ZRAM_ZERO);
+		if (!zram->table[index].element)
 			zram_stat_dec(&zram->stats.pages_zero);
-		}
+		zram_stat_dec(&zram->stats.pages_same);
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram->table[index].element = 0;
 		return;
 	}
 
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		clen = PAGE_SIZE;
-		__free_page(page);
+		__free_page(zram->table[index].page);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
 		zram_stat_dec(&zram->stats.pages_expand);
-		goto out;
-	}
-
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
+		zram_stat64_sub(zram, &zram->stats.compr_size, PAGE_SIZE);
+	} else if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, zram->table[index].entry);
+	} else
+		zram_free_obj(zram, handle, zram->table[index].size);
 
-	xv_free(zram->mem_pool, page, offset);
-	if (clen <= PAGE_SIZE / 2)
-		zram_stat_dec(&zram->stats.good_compress);
-
-out:
-	zram_stat64_sub(zram, &zram->stats.compr_size, clen);
 	zram_stat_dec(&zram->stats.pages_stored);
 
-	zram->table[index].page = NULL;
-	zram->table[index].offset = 0;
+	zram->table[index].handle = 0;
+	zram->table[index].size = 0;
 }
 
-static void handle_zero_page(struct page *page)
+static void handle_same_page(struct page *page, unsigned long element)
 {
 	void *user_mem;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	memset(user_mem, 0, PAGE_SIZE);
+	if (element) {
+		unsigned int pos;
+		unsigned long *p = user_mem;
+
+		for (pos = 0; pos != PAGE_SIZE / sizeof(*p); pos++)
+			p[pos] = element;
+	} else
+		memset(user_mem, 0, PAGE_SIZE);
 	kunmap_atomic(user_mem, KM_USER0);
 
 	flush_dcache_page(page);
@@ -194,14 +451,142 @@ static void handle_uncompressed_page(struct zram *zram,
 	unsigned char *user_mem, *cmem;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-			zram->table[index].offset;
+	cmem = kmap_atomic(zram->table[index].page, KM_USER1);
 
 	memcpy(user_mem, cmem, PAGE_SIZE);
-	kunmap_atomic(user_mem, KM_USER0);
 	kunmap_atomic(cmem, KM_USER1);
+	kunmap_atomic(user_mem, KM_USER0);
+
+	flush_dcache_page(page);
+}
+
+/*
+ * Fill page from a slot held in memory, compressed or not. Called
+ * with table_lock held.
+ */
+static int zram_decompress_slot(struct zram *zram, struct zram_stream *zstrm,
+				u32 index, struct page *page)
+{
+	int ret;
+	ktime_t start;
+	unsigned int clen;
+	u16 size;
+	unsigned long handle;
+	unsigned char *user_mem, *cmem;
+
+	/* Page is stored uncompressed since it's incompressible */
+	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		handle_uncompressed_page(zram, page, index);
+		return 0;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		handle = zram->table[index].entry->handle;
+		size = zram->table[index].entry->clen;
+	} else {
+		handle = zram->table[index].handle;
+		size = zram->table[index].size;
+	}
+
+	user_mem = kmap_atomic(page, KM_USER0);
+	clen = PAGE_SIZE;
+
+	cmem = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
 
+	start = ktime_get();
+	ret = crypto_comp_decompress(zstrm->tfm, cmem, size,
+		user_mem, &clen);
+
+	zs_unmap_object(zram->mem_pool, handle);
+	kunmap_atomic(user_mem, KM_USER0);
+
+	/* Should NEVER happen. */
+	if (unlikely(ret || clen != PAGE_SIZE)) {
+		pr_err("Decompression failed! err=%d, page=%u\n",
+			ret, index);
+		return -EIO;
+	}
+
+	zram_backend_stat_decompress(zram,
+		ktime_to_ns(ktime_sub(ktime_get(), start)));
 	flush_dcache_page(page);
+
+	return 0;
+}
+
+static void zram_bdev_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* Synchronously move one page to or from the backing device */
+static int zram_bdev_rw(struct zram *zram, int rw, struct page *page,
+			unsigned long blk)
+{
+	int ret = 0;
+	struct bio *bio;
+	DECLARE_COMPLETION_ONSTACK(done);
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = (sector_t)blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = zram_bdev_end_io;
+	bio->bi_private = &done;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		ret = -EIO;
+	bio_put(bio);
+
+	return ret;
+}
+
+struct zram_bdev_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int ret;
+};
+
+static void zram_bdev_read_work(struct work_struct *work)
+{
+	struct zram_bdev_work *zw;
+
+	zw = container_of(work, struct zram_bdev_work, work);
+	zw->ret = zram_bdev_rw(zw->zram, READ_SYNC, zw->page, zw->blk);
+}
+
+/*
+ * Read a written back page. Bios submitted from within a
+ * make_request_fn are only dispatched once it returns, so waiting
+ * for one here would deadlock: hand the I/O to a worker instead.
+ */
+static int zram_bdev_read(struct zram *zram, struct page *page,
+			unsigned long blk)
+{
+	struct zram_bdev_work zw;
+
+	zw.zram = zram;
+	zw.page = page;
+	zw.blk = blk;
+	INIT_WORK_ONSTACK(&zw.work, zram_bdev_read_work);
+	queue_work(system_unbound_wq, &zw.work);
+	flush_work(&zw.work);
+	destroy_work_on_stack(&zw.work);
+
+	if (!zw.ret)
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+
+	return zw.ret;
 }
 
 static void zram_read(struct zram *zram, struct bio *bio)
@@ -210,72 +595,86 @@ static void zram_read(struct zram *zram, struct bio *bio)
 	int i;
 	u32 index;
 	struct bio_vec *bvec;
+	struct zram_stream *zstrm;
 
 	zram_stat64_inc(zram, &zram->stats.num_reads);
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
+	/* Taken up front: we cannot sleep for one under table_lock */
+	zstrm = zram_stream_get(zram);
+
 	bio_for_each_segment(bvec, bio, i) {
 		int ret;
-		size_t clen;
 		struct page *page;
-		struct zobj_header *zheader;
-		unsigned char *user_mem, *cmem;
 
 		page = bvec->bv_page;
 
-		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-			handle_zero_page(page);
+		/* Any access makes the slot hot again */
+		if (unlikely(zram_test_flag(zram, index, ZRAM_IDLE))) {
+			write_lock(&zram->table_lock);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			write_unlock(&zram->table_lock);
+		}
+
+		read_lock(&zram->table_lock);
+		if (zram_test_flag(zram, index, ZRAM_SAME)) {
+			unsigned long element = zram->table[index].element;
+
+			read_unlock(&zram->table_lock);
+			handle_same_page(page, element);
 			index++;
 			continue;
 		}
 
-		/* Requested page is not present in compressed area */
-		if (unlikely(!zram->table[index].page)) {
-			pr_debug("Read before write: sector=%lu, size=%u",
-				(ulong)(bio->bi_sector), bio->bi_size);
-			handle_zero_page(page);
+		if (zram_test_flag(zram, index, ZRAM_WB)) {
+			unsigned long blk = zram->table[index].element;
+
+			/* Keeps blk from being reused until we are done */
+			atomic_inc(&zram->wb_reads);
+			read_unlock(&zram->table_lock);
+			ret = zram_bdev_read(zram, page, blk);
+			zram_wb_read_done(zram);
+			if (unlikely(ret)) {
+				pr_err("Backing device read failed! err=%d, "
+					"page=%u\n", ret, index);
+				zram_stat64_inc(zram,
+					&zram->stats.failed_reads);
+				goto out;
+			}
+			flush_dcache_page(page);
 			index++;
 			continue;
 		}
 
-		/* Page is stored uncompressed since it's incompressible */
-		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-			handle_uncompressed_page(zram, page, index);
+		/* Requested page is not present in compressed area */
+		if (unlikely(!zram->table[index].handle)) {
+			read_unlock(&zram->table_lock);
+			pr_debug("Read before write: sector=%lu, size=%u",
+				(ulong)(bio->bi_sector), bio->bi_size);
+			handle_same_page(page, 0);
 			index++;
 			continue;
 		}
 
-		user_mem = kmap_atomic(page, KM_USER0);
-		clen = PAGE_SIZE;
-
-		cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-				zram->table[index].offset;
+		ret = zram_decompress_slot(zram, zstrm, index, page);
+		read_unlock(&zram->table_lock);
 
-		ret = lzo1x_decompress_safe(
-			cmem + sizeof(*zheader),
-			xv_get_object_size(cmem) - sizeof(*zheader),
-			user_mem, &clen);
-
-		kunmap_atomic(user_mem, KM_USER0);
-		kunmap_atomic(cmem, KM_USER1);
-
-		/* Should NEVER happen. Return bio error if it does. */
-		if (unlikely(ret != LZO_E_OK)) {
-			pr_err("Decompression failed! err=%d, page=%u\n",
-				ret, index);
+		/* Return bio error if it fails. */
+		if (unlikely(ret)) {
 			zram_stat64_inc(zram, &zram->stats.failed_reads);
 			goto out;
 		}
 
-		flush_dcache_page(page);
 		index++;
 	}
 
+	zram_stream_put(zram, zstrm);
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return;
 
 out:
+	zram_stream_put(zram, zstrm);
 	bio_io_error(bio);
 }
 
@@ -290,46 +689,88 @@ static void zram_write(struct zram *zram, struct bio *bio)
 
 	bio_for_each_segment(bvec, bio, i) {
 		int ret;
-		u32 offset;
-		size_t clen;
-		struct zobj_header *zheader;
-		struct page *page, *page_store;
+		ktime_t start;
+		u32 checksum = 0;
+		unsigned int clen;
+		unsigned long element;
+		unsigned long handle = 0;
+		struct zram_dedup_entry *entry = NULL;
+		struct zram_stream *zstrm;
+		struct page *page, *page_store = NULL;
 		unsigned char *user_mem, *cmem, *src;
 
 		page = bvec->bv_page;
-		src = zram->compress_buffer;
-
-		/*
-		 * System overwrites unused sectors. Free memory associated
-		 * with this sector now.
-		 */
-		if (zram->table[index].page ||
-				zram_test_flag(zram, index, ZRAM_ZERO))
-			zram_free_page(zram, index);
-
-		mutex_lock(&zram->lock);
+		zstrm = zram_stream_get(zram);
+		src = zstrm->buffer;
 
 		user_mem = kmap_atomic(page, KM_USER0);
-		if (page_zero_filled(user_mem)) {
+		if (page_same_filled(user_mem, &element)) {
 			kunmap_atomic(user_mem, KM_USER0);
-			mutex_unlock(&zram->lock);
-			zram_stat_inc(&zram->stats.pages_zero);
-			zram_set_flag(zram, index, ZRAM_ZERO);
+			zram_stream_put(zram, zstrm);
+
+			write_lock(&zram->table_lock);
+			/*
+			 * System overwrites unused sectors. Free memory
+			 * associated with this sector now.
+			 */
+			zram_free_page(zram, index);
+			if (!element)
+				zram_stat_inc(&zram->stats.pages_zero);
+			zram_stat_inc(&zram->stats.pages_same);
+			zram->table[index].element = element;
+			zram_set_flag(zram, index, ZRAM_SAME);
+			write_unlock(&zram->table_lock);
 			index++;
 			continue;
 		}
 
-		ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-					zram->compress_workmem);
+		clen = 2 * PAGE_SIZE;
+		start = ktime_get();
+		ret = crypto_comp_compress(zstrm->tfm, user_mem, PAGE_SIZE,
+					src, &clen);
 
 		kunmap_atomic(user_mem, KM_USER0);
 
-		if (unlikely(ret != LZO_E_OK)) {
-			mutex_unlock(&zram->lock);
+		if (unlikely(ret)) {
+			zram_stream_put(zram, zstrm);
 			pr_err("Compression failed! err=%d\n", ret);
 			zram_stat64_inc(zram, &zram->stats.failed_writes);
 			goto out;
 		}
+		zram_backend_stat_compress(zram, clen,
+			ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+		/* Share an identical object if one is already stored */
+		if (zram->dedup_enable && clen <= max_zpage_size) {
+			checksum = jhash(src, clen, 0);
+			entry = zram_dedup_find(zram, src, clen, checksum);
+			if (entry) {
+				zram_stream_put(zram, zstrm);
+
+				write_lock(&zram->table_lock);
+				zram_free_page(zram, index);
+				zram->table[index].entry = entry;
+				zram_set_flag(zram, index, ZRAM_DEDUP);
+				zram_stat_inc(&zram->stats.pages_stored);
+				zram_stat_inc(&zram->stats.pages_dup);
+				write_unlock(&zram->table_lock);
+
+				zram_stat64_add(zram, &zram->stats.dup_size,
+						clen);
+				index++;
+				continue;
+			}
+
+			entry = kmalloc(sizeof(*entry), GFP_NOIO);
+			if (unlikely(!entry)) {
+				zram_stream_put(zram, zstrm);
+				pr_info("Error allocating dedup entry for "
+					"page: %u\n", index);
+				zram_stat64_inc(zram,
+					&zram->stats.failed_writes);
+				goto out;
+			}
+		}
 
 		/*
 		 * Page is incompressible. Store it as-is (uncompressed)
@@ -340,7 +781,7 @@ static void zram_write(struct zram *zram, struct bio *bio)
 			clen = PAGE_SIZE;
 			page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 			if (unlikely(!page_store)) {
-				mutex_unlock(&zram->lock);
+				zram_stream_put(zram, zstrm);
 				pr_info("Error allocating memory for "
 					"incompressible page: %u\n", index);
 				zram_stat64_inc(zram,
@@ -348,52 +789,61 @@ static void zram_write(struct zram *zram, struct bio *bio)
 				goto out;
 			}
 
-			offset = 0;
-			zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-			zram_stat_inc(&zram->stats.pages_expand);
-			zram->table[index].page = page_store;
 			src = kmap_atomic(page, KM_USER0);
-			goto memstore;
-		}
+			cmem = kmap_atomic(page_store, KM_USER1);
+			memcpy(cmem, src, clen);
+			kunmap_atomic(cmem, KM_USER1);
+			kunmap_atomic(src, KM_USER0);
+		} else {
+			handle = zs_malloc(zram->mem_pool, clen);
+			if (unlikely(!handle)) {
+				kfree(entry);
+				zram_stream_put(zram, zstrm);
+				pr_info("Error allocating memory for "
+					"compressed page: %u, size=%u\n",
+					index, clen);
+				zram_stat64_inc(zram,
+					&zram->stats.failed_writes);
+				goto out;
+			}
 
-		if (xv_malloc(zram->mem_pool, clen + sizeof(*zheader),
-				&zram->table[index].page, &offset,
-				GFP_NOIO | __GFP_HIGHMEM)) {
-			mutex_unlock(&zram->lock);
-			pr_info("Error allocating memory for compressed "
-				"page: %u, size=%zu\n", index, clen);
-			zram_stat64_inc(zram, &zram->stats.failed_writes);
-			goto out;
+			cmem = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+			memcpy(cmem, src, clen);
+			zs_unmap_object(zram->mem_pool, handle);
 		}
+		zram_stream_put(zram, zstrm);
 
-memstore:
-		zram->table[index].offset = offset;
-
-		cmem = kmap_atomic(zram->table[index].page, KM_USER1) +
-				zram->table[index].offset;
-
-#if 0
-		/* Back-reference needed for memory defragmentation */
-		if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-			zheader = (struct zobj_header *)cmem;
-			zheader->table_idx = index;
-			cmem += sizeof(*zheader);
+		/*
+		 * The new object is complete; swap it into the table,
+		 * freeing whatever this sector held before.
+		 */
+		write_lock(&zram->table_lock);
+		zram_free_page(zram, index);
+		if (entry) {
+			entry->checksum = checksum;
+			entry->refcount = 1;
+			entry->handle = handle;
+			entry->clen = clen;
+			zram_dedup_insert(zram, entry);
+			zram->table[index].entry = entry;
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+		} else if (handle) {
+			zram->table[index].handle = handle;
+			zram->table[index].size = clen;
+		}
+		if (unlikely(clen == PAGE_SIZE)) {
+			zram->table[index].page = page_store;
+			zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+			zram_stat_inc(&zram->stats.pages_expand);
 		}
-#endif
-
-		memcpy(cmem, src, clen);
-
-		kunmap_atomic(cmem, KM_USER1);
-		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-			kunmap_atomic(src, KM_USER0);
 
 		/* Update stats */
-		zram_stat64_add(zram, &zram->stats.compr_size, clen);
 		zram_stat_inc(&zram->stats.pages_stored);
 		if (clen <= PAGE_SIZE / 2)
 			zram_stat_inc(&zram->stats.good_compress);
+		write_unlock(&zram->table_lock);
 
-		mutex_unlock(&zram->lock);
+		zram_stat64_add(zram, &zram->stats.compr_size, clen);
 		index++;
 	}
 
@@ -405,6 +855,223 @@ out:
 	bio_io_error(bio);
 }
 
+/*
+ * Release the backing device. None of its blocks may be referenced
+ * by the table any more.
+ */
+static void zram_put_backing_dev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	vfree(zram->bitmap);
+	vfree(zram->free_pending);
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->free_pending = NULL;
+	zram->nr_free_pending = 0;
+	zram->nr_blocks = 0;
+}
+
+int zram_set_backing_dev(struct zram *zram, const char *path)
+{
+	int ret;
+	unsigned long nr_blocks, *bitmap, *free_pending;
+	struct block_device *bdev;
+
+	mutex_lock(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Cannot change backing_dev for initialized device\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	zram_put_backing_dev(zram);
+	ret = 0;
+	if (!strcmp(path, "none"))
+		goto out;
+
+	bdev = blkdev_get_by_path(path, FMODE_READ | FMODE_WRITE |
+				FMODE_EXCL, zram);
+	if (IS_ERR(bdev)) {
+		ret = PTR_ERR(bdev);
+		goto out;
+	}
+
+	ret = -EINVAL;
+	nr_blocks = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (nr_blocks < 2)
+		goto put_bdev;
+
+	ret = set_blocksize(bdev, PAGE_SIZE);
+	if (ret)
+		goto put_bdev;
+
+	ret = -ENOMEM;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap)
+		goto put_bdev;
+	free_pending = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!free_pending) {
+		vfree(bitmap);
+		goto put_bdev;
+	}
+
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->free_pending = free_pending;
+	zram->nr_blocks = nr_blocks;
+	pr_info("%s: writing back to %s (%lu pages)\n",
+		zram->disk->disk_name, path, nr_blocks - 1);
+	mutex_unlock(&zram->init_lock);
+
+	return 0;
+
+put_bdev:
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+out:
+	mutex_unlock(&zram->init_lock);
+	return ret;
+}
+
+/*
+ * Flag every stored slot as idle. Reads and writes clear the flag,
+ * so the slots still flagged on a later writeback have not been
+ * touched since.
+ */
+int zram_mark_idle(struct zram *zram)
+{
+	u32 index;
+
+	mutex_lock(&zram->init_lock);
+	if (!zram->init_done) {
+		mutex_unlock(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		write_lock(&zram->table_lock);
+		if (zram->table[index].handle &&
+				!zram_test_flag(zram, index, ZRAM_SAME))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		write_unlock(&zram->table_lock);
+	}
+	mutex_unlock(&zram->init_lock);
+
+	return 0;
+}
+
+/*
+ * Shared objects are left alone: they usually back more memory than
+ * a block of the backing device can free.
+ */
+static int zram_wb_candidate(struct zram *zram, u32 index,
+				enum zram_wb_mode mode)
+{
+	if (!zram->table[index].handle ||
+	    zram->table[index].flags & (BIT(ZRAM_SAME) | BIT(ZRAM_DEDUP) |
+					BIT(ZRAM_WB) | BIT(ZRAM_UNDER_WB)))
+		return 0;
+
+	if (mode == ZRAM_WB_HUGE)
+		return zram_test_flag(zram, index, ZRAM_UNCOMPRESSED);
+
+	return zram_test_flag(zram, index, ZRAM_IDLE);
+}
+
+/*
+ * Move one slot to the backing device. The slot is flagged
+ * ZRAM_UNDER_WB while its page is in flight; if it is rewritten or
+ * freed meanwhile the flag is gone and the block is dropped instead.
+ */
+static int zram_writeback_slot(struct zram *zram, u32 index,
+				enum zram_wb_mode mode, struct page *page)
+{
+	int ret;
+	unsigned long blk;
+	struct zram_stream *zstrm;
+
+	/* Unlocked peek, so that most slots cost no stream or block */
+	if (!zram_wb_candidate(zram, index, mode))
+		return 0;
+
+	blk = zram_alloc_block(zram);
+	if (!blk)
+		return -ENOSPC;
+
+	zstrm = zram_stream_get(zram);
+	write_lock(&zram->table_lock);
+	if (!zram_wb_candidate(zram, index, mode)) {
+		write_unlock(&zram->table_lock);
+		zram_stream_put(zram, zstrm);
+		zram_free_block(zram, blk);
+		return 0;
+	}
+
+	ret = zram_decompress_slot(zram, zstrm, index, page);
+	if (!ret)
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+	write_unlock(&zram->table_lock);
+	zram_stream_put(zram, zstrm);
+	if (ret)
+		goto free_block;
+
+	ret = zram_bdev_rw(zram, WRITE, page, blk);
+
+	write_lock(&zram->table_lock);
+	if (ret || !zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		write_unlock(&zram->table_lock);
+		goto free_block;
+	}
+
+	zram_free_page(zram, index);
+	zram->table[index].element = blk;
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram_stat_inc(&zram->stats.pages_stored);
+	zram_stat_inc(&zram->stats.pages_wb);
+	write_unlock(&zram->table_lock);
+
+	zram_stat64_inc(zram, &zram->stats.bd_writes);
+	return 0;
+
+free_block:
+	zram_free_block(zram, blk);
+	return ret;
+}
+
+int zram_writeback(struct zram *zram, enum zram_wb_mode mode)
+{
+	int ret = 0;
+	u32 index;
+	struct page *page;
+
+	mutex_lock(&zram->init_lock);
+	if (!zram->init_done || !zram->bdev) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		ret = zram_writeback_slot(zram, index, mode, page);
+		if (ret)
+			break;
+		cond_resched();
+	}
+	__free_page(page);
+
+out:
+	mutex_unlock(&zram->init_lock);
+	return ret;
+}
+
 /*
  * Check if request is within bounds and page aligned.
  */
@@ -460,34 +1127,52 @@ void zram_reset_device(struct zram *zram)
 	mutex_lock(&zram->init_lock);
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+	/* Free streams */
+	while (!list_empty(&zram->idle_streams)) {
+		struct zram_stream *zstrm;
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+		zstrm = list_first_entry(&zram->idle_streams,
+					struct zram_stream, list);
+		list_del(&zstrm->list);
+		zram_stream_free(zstrm);
+	}
+	zram->nr_streams = 0;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
-
-		page = zram->table[index].page;
-		offset = zram->table[index].offset;
+		unsigned long handle = zram->table[index].handle;
 
-		if (!page)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
-			__free_page(page);
-		else
-			xv_free(zram->mem_pool, page, offset);
+			__free_page(zram->table[index].page);
+		else if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+			struct zram_dedup_entry *entry;
+
+			entry = zram->table[index].entry;
+			if (--entry->refcount)
+				continue;
+			zs_free(zram->mem_pool, entry->handle);
+			kfree(entry);
+		} else
+			zs_free(zram->mem_pool, handle);
+	}
+	zram->dedup_tree = RB_ROOT;
+
+	/* The backing device stays configured, but empty */
+	if (zram->bitmap) {
+		bitmap_zero(zram->bitmap, zram->nr_blocks);
+		bitmap_zero(zram->free_pending, zram->nr_blocks);
+		zram->nr_free_pending = 0;
 	}
 
 	vfree(zram->table);
 	zram->table = NULL;
 
-	xv_destroy_pool(zram->mem_pool);
+	if (zram->mem_pool)
+		zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
 	/* Reset stats */
@@ -500,6 +1185,7 @@ void zram_reset_device(struct zram *zram)
 int zram_init_device(struct zram *zram)
 {
 	int ret;
+	unsigned int i;
 	size_t num_pages;
 
 	mutex_lock(&zram->init_lock);
@@ -511,19 +1197,23 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail;
-	}
+	for (i = 0; i < zram->max_streams; i++) {
+		struct zram_stream *zstrm = zram_stream_alloc(zram);
 
-	zram->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
+		if (!zstrm)
+			break;
+		list_add(&zstrm->list, &zram->idle_streams);
+	}
+	if (!i) {
+		pr_err("Error allocating %s compression streams\n",
+			zram_backend_names[zram->backend]);
 		ret = -ENOMEM;
 		goto fail;
 	}
+	zram->nr_streams = i;
+	if (i < zram->max_streams)
+		pr_warning("Only %u of %u compression streams allocated\n",
+			i, zram->max_streams);
 
 	num_pages = zram->disksize >> PAGE_SHIFT;
 	zram->table = vzalloc(num_pages * sizeof(*zram->table));
@@ -540,7 +1230,8 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = xv_create_pool();
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -566,7 +1257,9 @@ void zram_slot_free_notify(struct block_device *bdev, unsigned long index)
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	write_lock(&zram->table_lock);
 	zram_free_page(zram, index);
+	write_unlock(&zram->table_lock);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -579,9 +1272,15 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	mutex_init(&zram->lock);
 	mutex_init(&zram->init_lock);
+	rwlock_init(&zram->table_lock);
 	spin_lock_init(&zram->stat64_lock);
+	spin_lock_init(&zram->stream_lock);
+	spin_lock_init(&zram->dedup_lock);
+	zram->dedup_tree = RB_ROOT;
+	INIT_LIST_HEAD(&zram->idle_streams);
+	init_waitqueue_head(&zram->stream_wait);
+	zram->max_streams = num_online_cpus();
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -713,6 +1412,7 @@ static void __exit zram_exit(void)
 		destroy_device(zram);
 		if (zram->init_done)
 			zram_reset_device(zram);
+		zram_put_backing_dev(zram);
 	}
 
 	unregister_blkdev(zram_major, "zram");
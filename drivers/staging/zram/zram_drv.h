@@ -17,8 +17,11 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/crypto.h>
+#include <linux/rbtree.h>
 
-#include "xvmalloc.h"
+#include "../zsmalloc/zsmalloc.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -26,18 +29,6 @@
  */
 static const unsigned max_num_devices = 32;
 
-/*
- * Stored at beginning of each compressed object.
- *
- * It stores back-reference to table entry which points to this
- * object. This is required to support memory defragmentation.
- */
-struct zobj_header {
-#if 0
-	u32 table_idx;
-#endif
-};
-
 /*-- Configurable parameters */
 
 /* Default zram disk size: 25% of total RAM */
@@ -51,8 +42,8 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /*
  * NOTE: max_zpage_size must be less than or equal to:
- *   XV_MAX_ALLOC_SIZE - sizeof(struct zobj_header)
- * otherwise, xv_malloc() would always return failure.
+ *   ZS_MAX_ALLOC_SIZE
+ * otherwise, zs_malloc() would always return failure.
  */
 
 /*-- End of configurable params */
@@ -68,18 +59,63 @@ enum zram_pageflags {
 	/* Page is stored uncompressed */
 	ZRAM_UNCOMPRESSED,
 
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page is one word repeated; table[].element holds the word */
+	ZRAM_SAME,
+
+	/* Page is a shared object; table[].entry points to it */
+	ZRAM_DEDUP,
+
+	/* Page is on the backing device; table[].element is its block */
+	ZRAM_WB,
+
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+
+	/* Page has not been accessed since slots were last marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+/* Compression backends, selected through sysfs comp_algorithm */
+enum zram_backend {
+	ZRAM_BACKEND_LZO,
+	ZRAM_BACKEND_DEFLATE,
+	ZRAM_BACKEND_LZ4,
+
+	__NR_ZRAM_BACKENDS,
+};
+
+/* What zram_writeback() moves to the backing device */
+enum zram_wb_mode {
+	ZRAM_WB_IDLE,		/* slots still marked idle */
+	ZRAM_WB_HUGE,		/* slots stored uncompressed */
+};
+
 /*-- Data structures */
 
+/*
+ * A compressed object that may back several disk pages. Objects
+ * are indexed by a hash of their compressed bytes: the compressor
+ * is deterministic, so equal pages give equal objects.
+ */
+struct zram_dedup_entry {
+	struct rb_node node;
+	u32 checksum;
+	u32 refcount;		/* no. of table entries using it */
+	unsigned long handle;
+	u16 clen;
+};
+
 /* Allocated for each disk page */
 struct table {
-	struct page *page;
-	u16 offset;
+	union {
+		unsigned long handle;		/* zsmalloc object */
+		struct page *page;		/* ZRAM_UNCOMPRESSED */
+		unsigned long element;		/* ZRAM_SAME, ZRAM_WB */
+		struct zram_dedup_entry *entry;	/* ZRAM_DEDUP */
+	};
+	u16 size;	/* compressed size of a zsmalloc object */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __attribute__((aligned(4)));
@@ -92,20 +128,73 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 dup_size;		/* compressed bytes saved by sharing */
+	u64 bd_reads;		/* pages read from the backing device */
+	u64 bd_writes;		/* pages written to the backing device */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of same filled pages, incl. zero */
+	u32 pages_dup;		/* no. of pages sharing another's object */
 	u32 pages_stored;	/* no. of pages currently stored */
+	u32 pages_wb;		/* no. of them on the backing device */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
 };
 
+/*
+ * Cost of each backend on this device. Unlike zram_stats these are
+ * kept across reset, so backends can be compared one after another
+ * on the same workload.
+ */
+struct zram_backend_stats {
+	u64 pages_compressed;
+	u64 orig_size;		/* bytes fed to the compressor */
+	u64 compr_size;		/* bytes it produced */
+	u64 compress_ns;
+	u64 pages_decompressed;
+	u64 decompress_ns;
+};
+
+/*
+ * Compression context. Each reader and writer takes one off the
+ * device's idle list, so as many pages can be (de)compressed in
+ * parallel as there are streams. Some backends (deflate) keep state
+ * in the tfm, hence readers need one as well.
+ */
+struct zram_stream {
+	struct crypto_comp *tfm;
+	void *buffer;		/* 2 pages: output may exceed PAGE_SIZE */
+	struct list_head list;
+};
+
 struct zram {
-	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zs_pool *mem_pool;
 	struct table *table;
+	rwlock_t table_lock;	/* protect table entries and page stats */
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct mutex lock;	/* protect compression buffers against
-				 * concurrent writes */
+	spinlock_t stream_lock;	/* protect idle_streams */
+	struct list_head idle_streams;
+	wait_queue_head_t stream_wait;
+	unsigned int max_streams;	/* as configured */
+	unsigned int nr_streams;	/* actually allocated */
+	enum zram_backend backend;
+	int dedup_enable;
+	spinlock_t dedup_lock;	/* protect dedup_tree and refcounts */
+	struct rb_root dedup_tree;
+	/*
+	 * Optional block device that cold and incompressible pages are
+	 * written back to, one page per block. Bit n of bitmap is set
+	 * while block n is in use; block 0 is never used.
+	 *
+	 * Blocks freed while a read from the device is in flight are
+	 * only marked in free_pending; the last reader releases them,
+	 * so a block is never reused under a reader.
+	 */
+	struct block_device *bdev;
+	unsigned long *bitmap;
+	unsigned long *free_pending;
+	unsigned long nr_free_pending;
+	atomic_t wb_reads;	/* reads from bdev in flight */
+	unsigned long nr_blocks;
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -118,15 +207,20 @@ struct zram {
 	u64 disksize;	/* bytes */
 
 	struct zram_stats stats;
+	struct zram_backend_stats backend_stats[__NR_ZRAM_BACKENDS];
 };
 
 extern struct zram *devices;
 extern unsigned int num_devices;
+extern const char *const zram_backend_names[__NR_ZRAM_BACKENDS];
 #ifdef CONFIG_SYSFS
 extern struct attribute_group zram_disk_attr_group;
 #endif
 
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
+extern int zram_set_backing_dev(struct zram *zram, const char *path);
+extern int zram_mark_idle(struct zram *zram);
+extern int zram_writeback(struct zram *zram, enum zram_wb_mode mode);
 
 #endif
@@ -0,0 +1,926 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Copyright (C) 2011  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the license that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+/*
+ * zsmalloc packs compressed pages for zram and zcache. Objects of
+ * similar size share a size class, and each class carves zspages
+ * (see zsmalloc_int.h) into equal slots, so a freed slot is always
+ * reusable by the next object of that class and the only waste is
+ * the rounding up to the class size.
+ *
+ * Allocation returns an opaque handle rather than an address. The
+ * object must be mapped with zs_map_object() before use, and while
+ * it is mapped it is pinned. Unpinned objects may be moved by
+ * compaction, which empties sparsely used zspages into fuller ones
+ * of the same class and frees them. Compaction runs on demand
+ * through zs_compact() and from a shrinker under memory pressure.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
+#include <linux/errno.h>
+#include <linux/highmem.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/tlbflush.h>
+
+#include "zsmalloc.h"
+#include "zsmalloc_int.h"
+
+static struct kmem_cache *handle_cachep;
+static struct kmem_cache *zspage_cachep;
+
+static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
+
+/* Index of the smallest class that fits 'size', header included */
+static int get_size_class_index(int size)
+{
+	int idx = 0;
+
+	if (likely(size > ZS_MIN_ALLOC_SIZE))
+		idx = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
+				ZS_SIZE_CLASS_DELTA);
+
+	return idx;
+}
+
+/*
+ * Number of pages per zspage that wastes the least space for
+ * objects of the given size.
+ */
+static int get_pages_per_zspage(int class_size)
+{
+	int i, max_usedpc = 0;
+	int max_usedpc_order = 1;
+
+	for (i = 1; i <= ZS_MAX_PAGES_PER_ZSPAGE; i++) {
+		int zspage_size;
+		int waste, usedpc;
+
+		zspage_size = i * PAGE_SIZE;
+		waste = zspage_size % class_size;
+		usedpc = (zspage_size - waste) * 100 / zspage_size;
+
+		if (usedpc > max_usedpc) {
+			max_usedpc = usedpc;
+			max_usedpc_order = i;
+		}
+	}
+
+	return max_usedpc_order;
+}
+
+static enum fullness_group get_fullness_group(struct size_class *class,
+						struct zspage *zspage)
+{
+	unsigned int inuse = zspage->inuse;
+	unsigned int max_objects = class->objs_per_zspage;
+
+	if (inuse == 0)
+		return ZS_EMPTY;
+	if (inuse == max_objects)
+		return ZS_FULL;
+	if (inuse <= 3 * max_objects / 4)
+		return ZS_ALMOST_EMPTY;
+	return ZS_ALMOST_FULL;
+}
+
+/* Empty zspages are never listed: they are freed right away */
+static void insert_zspage(struct size_class *class, struct zspage *zspage,
+				enum fullness_group fullness)
+{
+	zspage->fullness = fullness;
+	if (fullness == ZS_EMPTY)
+		return;
+
+	class->zspages[fullness]++;
+	list_add(&zspage->list, &class->fullness_list[fullness]);
+}
+
+static void remove_zspage(struct size_class *class, struct zspage *zspage)
+{
+	if (zspage->fullness == ZS_EMPTY)
+		return;
+
+	class->zspages[zspage->fullness]--;
+	list_del_init(&zspage->list);
+	zspage->fullness = ZS_EMPTY;
+}
+
+/*
+ * Move a zspage to the list matching its current usage. Returns the
+ * new fullness group.
+ */
+static enum fullness_group fix_fullness_group(struct size_class *class,
+						struct zspage *zspage)
+{
+	enum fullness_group newfg;
+
+	newfg = get_fullness_group(class, zspage);
+	if (newfg == zspage->fullness)
+		goto out;
+
+	remove_zspage(class, zspage);
+	insert_zspage(class, zspage, newfg);
+out:
+	return newfg;
+}
+
+/* Prefer the fullest zspages, to leave the others to be freed */
+static struct zspage *find_get_zspage(struct size_class *class)
+{
+	if (!list_empty(&class->fullness_list[ZS_ALMOST_FULL]))
+		return list_first_entry(&class->fullness_list[ZS_ALMOST_FULL],
+					struct zspage, list);
+	if (!list_empty(&class->fullness_list[ZS_ALMOST_EMPTY]))
+		return list_first_entry(&class->fullness_list[ZS_ALMOST_EMPTY],
+					struct zspage, list);
+	return NULL;
+}
+
+static unsigned long location_to_obj(struct zspage *zspage, unsigned int idx)
+{
+	unsigned long obj;
+
+	obj = page_to_pfn(zspage->pages[0]) << OBJ_INDEX_BITS;
+	obj |= idx & OBJ_INDEX_MASK;
+
+	return obj;
+}
+
+static struct zspage *obj_to_location(unsigned long obj, unsigned int *idx)
+{
+	struct page *first_page;
+
+	first_page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*idx = obj & OBJ_INDEX_MASK;
+
+	return (struct zspage *)page_private(first_page);
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle >> 1;
+}
+
+/* Caller holds the pin, or the handle is not yet visible to anyone */
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	unsigned long *slot = (unsigned long *)handle;
+
+	*slot = (obj << 1) | (*slot & (1UL << HANDLE_PIN_BIT));
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+/*
+ * Map the header word of object 'idx'. Headers are word aligned so
+ * never straddle a page.
+ */
+static unsigned long *obj_header(struct size_class *class,
+				struct zspage *zspage, unsigned int idx)
+{
+	unsigned long off = (unsigned long)idx * class->size;
+	void *addr;
+
+	addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+	return addr + (off & ~PAGE_MASK);
+}
+
+static void obj_header_unmap(unsigned long *hdr)
+{
+	kunmap_atomic(hdr, KM_USER0);
+}
+
+/*
+ * Copy 'len' bytes between a linear buffer and a range of a zspage
+ * that may cross page boundaries.
+ */
+static void zs_copy_from_obj(char *buf, struct zspage *zspage,
+				unsigned long off, int len)
+{
+	while (len) {
+		int in_page = off & ~PAGE_MASK;
+		int chunk = min_t(int, len, PAGE_SIZE - in_page);
+		char *addr;
+
+		addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+		memcpy(buf, addr + in_page, chunk);
+		kunmap_atomic(addr, KM_USER0);
+
+		buf += chunk;
+		off += chunk;
+		len -= chunk;
+	}
+}
+
+static void zs_copy_to_obj(struct zspage *zspage, unsigned long off,
+				const char *buf, int len)
+{
+	while (len) {
+		int in_page = off & ~PAGE_MASK;
+		int chunk = min_t(int, len, PAGE_SIZE - in_page);
+		char *addr;
+
+		addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT], KM_USER0);
+		memcpy(addr + in_page, buf, chunk);
+		kunmap_atomic(addr, KM_USER0);
+
+		buf += chunk;
+		off += chunk;
+		len -= chunk;
+	}
+}
+
+/* Copy the payload of an object between zspages of one class */
+static void zs_object_copy(struct size_class *class,
+			struct zspage *dst, unsigned int dst_idx,
+			struct zspage *src, unsigned int src_idx)
+{
+	unsigned long s_off, d_off;
+	int len = class->size - ZS_HANDLE_SIZE;
+
+	s_off = (unsigned long)src_idx * class->size + ZS_HANDLE_SIZE;
+	d_off = (unsigned long)dst_idx * class->size + ZS_HANDLE_SIZE;
+
+	while (len) {
+		int s_in = s_off & ~PAGE_MASK;
+		int d_in = d_off & ~PAGE_MASK;
+		int chunk = min_t(int, len, PAGE_SIZE - max(s_in, d_in));
+		char *s_addr, *d_addr;
+
+		s_addr = kmap_atomic(src->pages[s_off >> PAGE_SHIFT], KM_USER0);
+		d_addr = kmap_atomic(dst->pages[d_off >> PAGE_SHIFT], KM_USER1);
+		memcpy(d_addr + d_in, s_addr + s_in, chunk);
+		kunmap_atomic(d_addr, KM_USER1);
+		kunmap_atomic(s_addr, KM_USER0);
+
+		s_off += chunk;
+		d_off += chunk;
+		len -= chunk;
+	}
+}
+
+static void free_zspage(struct zs_pool *pool, struct size_class *class,
+			struct zspage *zspage)
+{
+	int i;
+
+	BUG_ON(zspage->inuse);
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		set_page_private(zspage->pages[i], 0);
+		__free_page(zspage->pages[i]);
+	}
+	kmem_cache_free(zspage_cachep, zspage);
+
+	atomic_long_sub(class->pages_per_zspage, &pool->pages_allocated);
+}
+
+/* Link all objects of a new zspage into its free list */
+static void init_zspage(struct size_class *class, struct zspage *zspage)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < class->objs_per_zspage; idx++) {
+		unsigned long *hdr = obj_header(class, zspage, idx);
+		unsigned int next = idx + 1;
+
+		if (next == class->objs_per_zspage)
+			next = OBJ_FREE_END;
+		*hdr = (unsigned long)next << 1;
+		obj_header_unmap(hdr);
+	}
+
+	zspage->freeobj = 0;
+	zspage->inuse = 0;
+}
+
+static struct zspage *alloc_zspage(struct zs_pool *pool,
+				struct size_class *class)
+{
+	int i;
+	struct zspage *zspage;
+
+	zspage = kmem_cache_zalloc(zspage_cachep,
+				pool->flags & ~__GFP_HIGHMEM);
+	if (!zspage)
+		return NULL;
+
+	INIT_LIST_HEAD(&zspage->list);
+	zspage->class_idx = class->index;
+	zspage->fullness = ZS_EMPTY;
+
+	for (i = 0; i < class->pages_per_zspage; i++) {
+		struct page *page = alloc_page(pool->flags);
+
+		if (!page)
+			goto fail;
+		zspage->pages[i] = page;
+	}
+	set_page_private(zspage->pages[0], (unsigned long)zspage);
+
+	init_zspage(class, zspage);
+	atomic_long_add(class->pages_per_zspage, &pool->pages_allocated);
+
+	return zspage;
+
+fail:
+	while (i--)
+		__free_page(zspage->pages[i]);
+	kmem_cache_free(zspage_cachep, zspage);
+	return NULL;
+}
+
+/* Take the first free object of a zspage for 'handle' */
+static unsigned long obj_malloc(struct size_class *class,
+				struct zspage *zspage, unsigned long handle)
+{
+	unsigned int idx = zspage->freeobj;
+	unsigned long *hdr;
+
+	BUG_ON(idx == OBJ_FREE_END);
+
+	hdr = obj_header(class, zspage, idx);
+	zspage->freeobj = *hdr >> 1;
+	*hdr = handle | OBJ_ALLOCATED_TAG;
+	obj_header_unmap(hdr);
+
+	zspage->inuse++;
+	class->objs_used++;
+
+	return location_to_obj(zspage, idx);
+}
+
+static void obj_free(struct size_class *class, struct zspage *zspage,
+			unsigned int idx)
+{
+	unsigned long *hdr;
+
+	hdr = obj_header(class, zspage, idx);
+	*hdr = (unsigned long)zspage->freeobj << 1;
+	obj_header_unmap(hdr);
+
+	zspage->freeobj = idx;
+	zspage->inuse--;
+	class->objs_used--;
+}
+
+/**
+ * zs_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ *
+ * On success, handle to the allocated object is returned,
+ * otherwise 0.
+ * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
+ */
+unsigned long zs_malloc(struct zs_pool *pool, size_t size)
+{
+	unsigned long handle, obj;
+	struct size_class *class;
+	struct zspage *zspage;
+
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
+		return 0;
+
+	handle = (unsigned long)kmem_cache_alloc(handle_cachep,
+				pool->flags & ~__GFP_HIGHMEM);
+	if (!handle)
+		return 0;
+	*(unsigned long *)handle = 0;
+
+	class = &pool->size_class[get_size_class_index(size + ZS_HANDLE_SIZE)];
+
+	spin_lock(&class->lock);
+	zspage = find_get_zspage(class);
+	if (!zspage) {
+		spin_unlock(&class->lock);
+		zspage = alloc_zspage(pool, class);
+		if (unlikely(!zspage)) {
+			kmem_cache_free(handle_cachep, (void *)handle);
+			return 0;
+		}
+		spin_lock(&class->lock);
+		class->objs_allocated += class->objs_per_zspage;
+	}
+
+	obj = obj_malloc(class, zspage, handle);
+	record_obj(handle, obj);
+	fix_fullness_group(class, zspage);
+	spin_unlock(&class->lock);
+
+	return handle;
+}
+EXPORT_SYMBOL_GPL(zs_malloc);
+
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	unsigned int idx;
+	struct zspage *zspage;
+	struct size_class *class;
+	enum fullness_group fullness;
+
+	if (unlikely(!handle))
+		return;
+
+	/* The pin keeps compaction away from this object */
+	pin_tag(handle);
+	zspage = obj_to_location(handle_to_obj(handle), &idx);
+	class = &pool->size_class[zspage->class_idx];
+
+	spin_lock(&class->lock);
+	obj_free(class, zspage, idx);
+	fullness = fix_fullness_group(class, zspage);
+	if (fullness == ZS_EMPTY)
+		class->objs_allocated -= class->objs_per_zspage;
+	spin_unlock(&class->lock);
+	unpin_tag(handle);
+
+	if (fullness == ZS_EMPTY)
+		free_zspage(pool, class, zspage);
+	kmem_cache_free(handle_cachep, (void *)handle);
+}
+EXPORT_SYMBOL_GPL(zs_free);
+
+/**
+ * zs_map_object - get address of allocated object from handle.
+ * @pool: pool from which the object was allocated
+ * @handle: handle returned from zs_malloc
+ * @mm: whether the contents are read, written or both
+ *
+ * Before using an object allocated from zs_malloc, it must be mapped
+ * using this function. When done with the object, it must be unmapped
+ * using zs_unmap_object. The object stays pinned in between, and
+ * preemption is disabled: only one object may be mapped at a time on
+ * a CPU and the caller must not sleep.
+ */
+void *zs_map_object(struct zs_pool *pool, unsigned long handle,
+			enum zs_mapmode mm)
+{
+	unsigned int idx;
+	unsigned long off;
+	int in_page, len;
+	struct zspage *zspage;
+	struct size_class *class;
+	struct mapping_area *area;
+
+	BUG_ON(!handle);
+
+	pin_tag(handle);
+	zspage = obj_to_location(handle_to_obj(handle), &idx);
+	class = &pool->size_class[zspage->class_idx];
+	off = (unsigned long)idx * class->size + ZS_HANDLE_SIZE;
+	in_page = off & ~PAGE_MASK;
+	len = class->size - ZS_HANDLE_SIZE;
+
+	area = &get_cpu_var(zs_map_area);
+	area->vm_mm = mm;
+	if (in_page + len <= PAGE_SIZE) {
+		/* this object is contained entirely within a page */
+		area->vm_addr = kmap_atomic(zspage->pages[off >> PAGE_SHIFT],
+					KM_USER1);
+		return area->vm_addr + in_page;
+	}
+
+	/* this object spans two pages */
+	area->vm_addr = NULL;
+	if (mm != ZS_MM_WO)
+		zs_copy_from_obj(area->vm_buf, zspage, off, len);
+	return area->vm_buf;
+}
+EXPORT_SYMBOL_GPL(zs_map_object);
+
+void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
+{
+	unsigned int idx;
+	unsigned long off;
+	struct zspage *zspage;
+	struct size_class *class;
+	struct mapping_area *area;
+
+	BUG_ON(!handle);
+
+	area = &__get_cpu_var(zs_map_area);
+	if (area->vm_addr) {
+		kunmap_atomic(area->vm_addr, KM_USER1);
+	} else if (area->vm_mm != ZS_MM_RO) {
+		zspage = obj_to_location(handle_to_obj(handle), &idx);
+		class = &pool->size_class[zspage->class_idx];
+		off = (unsigned long)idx * class->size + ZS_HANDLE_SIZE;
+		zs_copy_to_obj(zspage, off, area->vm_buf,
+				class->size - ZS_HANDLE_SIZE);
+	}
+	put_cpu_var(zs_map_area);
+
+	unpin_tag(handle);
+}
+EXPORT_SYMBOL_GPL(zs_unmap_object);
+
+u64 zs_get_total_size_bytes(struct zs_pool *pool)
+{
+	return (u64)atomic_long_read(&pool->pages_allocated) << PAGE_SHIFT;
+}
+EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
+
+/* Number of zspages that could be freed by packing this class */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_wasted;
+
+	obj_wasted = class->objs_allocated - class->objs_used;
+	return obj_wasted / class->objs_per_zspage;
+}
+
+/*
+ * Move objects from 'src' into the free slots of 'dst' until either
+ * runs out. Pinned (mapped or being freed) objects are left behind.
+ * Returns 0 once nothing movable is left in 'src'.
+ */
+static int migrate_zspage(struct size_class *class, struct zspage *dst,
+			struct zspage *src, unsigned int *src_idx)
+{
+	while (*src_idx < class->objs_per_zspage) {
+		unsigned long *hdr, handle, new_obj;
+		unsigned int idx = *src_idx;
+
+		if (dst->inuse == class->objs_per_zspage)
+			return 1;
+
+		hdr = obj_header(class, src, idx);
+		handle = *hdr;
+		obj_header_unmap(hdr);
+		(*src_idx)++;
+
+		if (!(handle & OBJ_ALLOCATED_TAG))
+			continue;
+		handle &= ~OBJ_ALLOCATED_TAG;
+		if (!trypin_tag(handle))
+			continue;
+
+		new_obj = obj_malloc(class, dst, handle);
+		zs_object_copy(class, dst, new_obj & OBJ_INDEX_MASK, src, idx);
+		record_obj(handle, new_obj);
+		obj_free(class, src, idx);
+		unpin_tag(handle);
+	}
+
+	return 0;
+}
+
+static unsigned long zs_compact_class(struct zs_pool *pool,
+				struct size_class *class)
+{
+	unsigned long pages_freed = 0;
+	struct zspage *src, *dst;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class) &&
+	       !list_empty(&class->fullness_list[ZS_ALMOST_EMPTY])) {
+		unsigned int src_idx = 0;
+		int more = 1;
+
+		/* The least recently filled zspage is likely the emptiest */
+		src = list_entry(class->fullness_list[ZS_ALMOST_EMPTY].prev,
+				struct zspage, list);
+		remove_zspage(class, src);
+
+		while (more && (dst = find_get_zspage(class))) {
+			remove_zspage(class, dst);
+			more = migrate_zspage(class, dst, src, &src_idx);
+			insert_zspage(class, dst, get_fullness_group(class, dst));
+		}
+
+		if (!src->inuse) {
+			class->objs_allocated -= class->objs_per_zspage;
+			spin_unlock(&class->lock);
+			free_zspage(pool, class, src);
+			pages_freed += class->pages_per_zspage;
+		} else {
+			insert_zspage(class, src, get_fullness_group(class, src));
+			spin_unlock(&class->lock);
+			/* Pinned objects left behind or nowhere to go */
+			if (!dst || src_idx == class->objs_per_zspage)
+				break;
+		}
+
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return pages_freed;
+}
+
+/**
+ * zs_compact - pack objects into as few zspages as possible
+ * @pool: pool to compact
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages_freed = 0;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		pages_freed += zs_compact_class(pool, &pool->size_class[i]);
+
+	atomic64_add(pages_freed, &pool->pages_compacted);
+	return pages_freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
+{
+	stats->pages_compacted = atomic64_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_pool_stats);
+
+static unsigned long zs_shrinker_count(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages = 0;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		pages += zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+	}
+
+	return pages;
+}
+
+/*
+ * Compaction only moves memory around, it never allocates, so it is
+ * safe from any reclaim context.
+ */
+static int zs_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					shrinker);
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	return min_t(unsigned long, zs_shrinker_count(pool), INT_MAX);
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *zs_stat_root;
+
+static int zs_stats_size_show(struct seq_file *s, void *v)
+{
+	int i;
+	struct zs_pool *pool = s->private;
+	unsigned long total_allocated = 0, total_used = 0;
+	unsigned long total_pages = 0;
+
+	seq_printf(s, " %5s %5s %13s %12s %7s %13s %10s %10s %9s\n",
+			"class", "size", "almost_empty", "almost_full",
+			"full", "obj_allocated", "obj_used", "pages_used",
+			"pages_per_zspage");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+		unsigned long empty, almost_full, full;
+		unsigned long allocated, used, pages;
+
+		spin_lock(&class->lock);
+		empty = class->zspages[ZS_ALMOST_EMPTY];
+		almost_full = class->zspages[ZS_ALMOST_FULL];
+		full = class->zspages[ZS_FULL];
+		allocated = class->objs_allocated;
+		used = class->objs_used;
+		spin_unlock(&class->lock);
+
+		if (!allocated)
+			continue;
+
+		pages = allocated / class->objs_per_zspage *
+				class->pages_per_zspage;
+		seq_printf(s, " %5u %5u %13lu %12lu %7lu %13lu %10lu %10lu %9d\n",
+			i, class->size, empty, almost_full, full,
+			allocated, used, pages, class->pages_per_zspage);
+
+		total_allocated += allocated;
+		total_used += used;
+		total_pages += pages;
+	}
+
+	seq_printf(s, "\n %5s %5s %13s %12s %7s %13lu %10lu %10lu\n",
+			"Total", "", "", "", "", total_allocated, total_used,
+			total_pages);
+	seq_printf(s, " pages_compacted: %llu\n",
+			(u64)atomic64_read(&pool->pages_compacted));
+
+	return 0;
+}
+
+static int zs_stats_size_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_size_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_size_ops = {
+	.open		= zs_stats_size_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (!zs_stat_root)
+		return;
+
+	pool->stat_dentry = debugfs_create_dir(pool->name, zs_stat_root);
+	if (IS_ERR_OR_NULL(pool->stat_dentry)) {
+		pool->stat_dentry = NULL;
+		return;
+	}
+	debugfs_create_file("classes", S_IRUGO, pool->stat_dentry, pool,
+			&zs_stat_size_ops);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->stat_dentry);
+}
+
+static void __init zs_stat_init(void)
+{
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+	if (IS_ERR(zs_stat_root))
+		zs_stat_root = NULL;
+}
+
+static void zs_stat_exit(void)
+{
+	debugfs_remove_recursive(zs_stat_root);
+}
+
+#else /* CONFIG_DEBUG_FS */
+
+static inline void zs_pool_stat_create(struct zs_pool *pool) { }
+static inline void zs_pool_stat_destroy(struct zs_pool *pool) { }
+static inline void zs_stat_init(void) { }
+static inline void zs_stat_exit(void) { }
+
+#endif
+
+/**
+ * zs_create_pool - Creates an allocation pool to work from.
+ * @name: name of the pool, used in debugfs
+ * @flags: allocation flags used to allocate pool pages
+ *
+ * This function must be called before anything when using
+ * the zsmalloc allocator.
+ *
+ * On success, a pointer to the newly created pool is returned,
+ * otherwise NULL.
+ */
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
+{
+	int i, j;
+	struct zs_pool *pool;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		class->size = ZS_MIN_ALLOC_SIZE + i * ZS_SIZE_CLASS_DELTA;
+		class->index = i;
+		class->pages_per_zspage = get_pages_per_zspage(class->size);
+		class->objs_per_zspage = class->pages_per_zspage *
+					PAGE_SIZE / class->size;
+		spin_lock_init(&class->lock);
+		for (j = 0; j < NR_ZS_FULLNESS; j++)
+			INIT_LIST_HEAD(&class->fullness_list[j]);
+	}
+
+	pool->flags = flags;
+	pool->name = name;
+	atomic_long_set(&pool->pages_allocated, 0);
+	atomic64_set(&pool->pages_compacted, 0);
+
+	pool->shrinker.shrink = zs_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
+	zs_pool_stat_create(pool);
+
+	return pool;
+}
+EXPORT_SYMBOL_GPL(zs_create_pool);
+
+/* All objects must have been freed */
+void zs_destroy_pool(struct zs_pool *pool)
+{
+	int i, fg;
+
+	zs_pool_stat_destroy(pool);
+	unregister_shrinker(&pool->shrinker);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		for (fg = 0; fg < NR_ZS_FULLNESS; fg++) {
+			if (!list_empty(&class->fullness_list[fg])) {
+				pr_info("Freeing non-empty class with size "
+					"%d, fullness group %d\n",
+					class->size, fg);
+			}
+		}
+	}
+	kfree(pool);
+}
+EXPORT_SYMBOL_GPL(zs_destroy_pool);
+
+static void zs_free_map_areas(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu(zs_map_area, cpu).vm_buf);
+}
+
+static int __init zs_init(void)
+{
+	int cpu;
+
+	handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					0, 0, NULL);
+	zspage_cachep = kmem_cache_create("zspage", sizeof(struct zspage),
+					0, 0, NULL);
+	if (!handle_cachep || !zspage_cachep)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		struct mapping_area *area = &per_cpu(zs_map_area, cpu);
+
+		area->vm_buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+		if (!area->vm_buf)
+			goto fail;
+	}
+
+	zs_stat_init();
+	return 0;
+
+fail:
+	zs_free_map_areas();
+	if (zspage_cachep)
+		kmem_cache_destroy(zspage_cachep);
+	if (handle_cachep)
+		kmem_cache_destroy(handle_cachep);
+	return -ENOMEM;
+}
+
+static void __exit zs_exit(void)
+{
+	zs_stat_exit();
+	zs_free_map_areas();
+	kmem_cache_destroy(zspage_cachep);
+	kmem_cache_destroy(handle_cachep);
+}
+
+module_init(zs_init);
+module_exit(zs_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_AUTHOR("Nitin Gupta <ngupta@vflare.org>");
@@ -0,0 +1,127 @@
+/*
+ * zsmalloc memory allocator
+ *
+ * Copyright (C) 2011  Nitin Gupta
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the license that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZS_MALLOC_INT_H_
+#define _ZS_MALLOC_INT_H_
+
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/mm.h>
+
+#include "zsmalloc.h"
+
+/*
+ * A zspage is a group of up to ZS_MAX_PAGES_PER_ZSPAGE 0-order pages
+ * treated as one contiguous range carved into objects of a single
+ * size class. Grouping pages lets sizes that do not divide PAGE_SIZE
+ * waste little space: objects are allowed to straddle two pages.
+ */
+#define ZS_MAX_PAGES_PER_ZSPAGE	4
+
+/* Every object starts with a header word, see OBJ_ALLOCATED_TAG */
+#define ZS_HANDLE_SIZE		(sizeof(unsigned long))
+
+/* Smallest object, header included; must be a multiple of 8 */
+#define ZS_MIN_ALLOC_SIZE	32
+
+/*
+ * Size classes are ZS_SIZE_CLASS_DELTA bytes apart: 16 bytes for 4K
+ * pages. Being a multiple of 8, every header is word aligned and so
+ * never straddles a page.
+ */
+#define ZS_SIZE_CLASS_DELTA	(PAGE_SIZE >> 8)
+#define ZS_SIZE_CLASSES		((PAGE_SIZE - ZS_MIN_ALLOC_SIZE) / \
+					ZS_SIZE_CLASS_DELTA + 1)
+
+/*
+ * An object is named by its location, an "obj":
+ *	<PFN of the zspage's first page> <object index in the zspage>
+ * shifted left by one so that bit 0 of a handle slot is free to pin
+ * the object. Users only see handles, which point to a slot holding
+ * the obj; compaction moves an object by rewriting its slot.
+ */
+/* A zspage holds at most 2^(PAGE_SHIFT - 3) objects; leave room for one more */
+#define OBJ_INDEX_BITS		(PAGE_SHIFT - 2)
+#define OBJ_INDEX_MASK		((1UL << OBJ_INDEX_BITS) - 1)
+#define HANDLE_PIN_BIT		0
+
+/*
+ * The header word of an allocated object holds its handle with this
+ * bit set; that of a free object holds the index of the next free
+ * object shifted left by one.
+ */
+#define OBJ_ALLOCATED_TAG	1UL
+#define OBJ_FREE_END		(OBJ_INDEX_MASK)
+
+/*
+ * zspages with no free object are full; those at most 3/4 used are
+ * almost empty and are where compaction takes objects from.
+ */
+enum fullness_group {
+	ZS_EMPTY,
+	ZS_ALMOST_EMPTY,
+	ZS_ALMOST_FULL,
+	ZS_FULL,
+	NR_ZS_FULLNESS,
+};
+
+struct zspage {
+	struct list_head list;		/* in class->fullness_list */
+	unsigned int class_idx;
+	enum fullness_group fullness;
+	unsigned int inuse;		/* no. of allocated objects */
+	unsigned int freeobj;		/* first free object or OBJ_FREE_END */
+	struct page *pages[ZS_MAX_PAGES_PER_ZSPAGE];
+};
+
+struct size_class {
+	spinlock_t lock;	/* protect everything below */
+	struct list_head fullness_list[NR_ZS_FULLNESS];
+	/* Object size, header included */
+	int size;
+	int pages_per_zspage;
+	int objs_per_zspage;
+	unsigned int index;
+
+	/* Fragmentation stats */
+	unsigned long zspages[NR_ZS_FULLNESS];
+	unsigned long objs_allocated;	/* capacity of all zspages */
+	unsigned long objs_used;
+};
+
+struct zs_pool {
+	struct size_class size_class[ZS_SIZE_CLASSES];
+
+	gfp_t flags;	/* allocation flags used when growing pool */
+	const char *name;
+	atomic_long_t pages_allocated;
+	atomic64_t pages_compacted;
+
+	struct shrinker shrinker;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *stat_dentry;
+#endif
+};
+
+/*
+ * Objects spanning two pages are copied to and from this per-cpu
+ * buffer on map/unmap rather than mapped contiguously, which would
+ * need page table updates and a TLB flush on every access.
+ */
+struct mapping_area {
+	char *vm_buf;		/* copy buffer for objects that span pages */
+	char *vm_addr;		/* address of kmap_atomic()'ed pages */
+	enum zs_mapmode vm_mm;	/* mapping mode */
+};
+
+#endif
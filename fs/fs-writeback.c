@@ -23,6 +23,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/writeback.h>
+#include <linux/pagevec.h>
 #include <linux/blkdev.h>
 #include <linux/backing-dev.h>
 #include <linux/buffer_head.h>
@@ -40,6 +41,10 @@ struct wb_writeback_work {
 	unsigned int for_kupdate:1;
 	unsigned int range_cyclic:1;
 	unsigned int for_background:1;
+	unsigned int for_reclaim:1;
+
+	struct inode *inode;		/* for_reclaim: the inode to write */
+	pgoff_t offset;			/* for_reclaim: first page to write */
 
 	struct list_head list;		/* pending work list */
 	struct completion *done;	/* set if the caller waits */
@@ -154,6 +159,119 @@ void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
 	__bdi_start_writeback(bdi, nr_pages, true);
 }
 
+/*
+ * For background writeback the caller does not have the sb pinned
+ * before calling writeback. So make sure that we do pin it, so it doesn't
+ * go away while we are writing inodes from it.
+ */
+static bool pin_sb_for_writeback(struct super_block *sb)
+{
+	spin_lock(&sb_lock);
+	if (list_empty(&sb->s_instances)) {
+		spin_unlock(&sb_lock);
+		return false;
+	}
+
+	sb->s_count++;
+	spin_unlock(&sb_lock);
+
+	if (down_read_trylock(&sb->s_umount)) {
+		if (sb->s_root)
+			return true;
+		up_read(&sb->s_umount);
+	}
+
+	put_super(sb);
+	return false;
+}
+
+/*
+ * Dirty pages reclaim runs into are written by the flusher in clusters:
+ * a page within RECLAIM_WB_GAP pages of the range of a queued work for
+ * the same inode extends that work instead of queueing a new one.
+ * Only the last few works queued are looked at.
+ */
+#define RECLAIM_WB_GAP		PAGEVEC_SIZE
+#define RECLAIM_WB_MAX_PAGES	256
+#define RECLAIM_WB_LOOKUP	8
+
+static bool reclaim_work_extend(struct wb_writeback_work *work,
+				pgoff_t offset)
+{
+	pgoff_t start = work->offset;
+	pgoff_t end = work->offset + work->nr_pages;
+
+	if (offset + RECLAIM_WB_GAP < start || offset > end + RECLAIM_WB_GAP)
+		return false;
+
+	start = min(start, offset);
+	end = max(end, offset + 1);
+	if (end - start > RECLAIM_WB_MAX_PAGES)
+		return false;
+
+	work->offset = start;
+	work->nr_pages = end - start;
+	return true;
+}
+
+/**
+ * bdi_start_inode_writeback - have the flusher write a page for reclaim
+ * @inode: the inode the page belongs to
+ * @offset: index of the page
+ *
+ * Description:
+ *   Queues WB_SYNC_NONE writeback of the page at @offset, together
+ *   with the pages around it that reclaim asks for before the flusher
+ *   gets to it.  Does not sleep.  Returns 0 if the page was queued, or
+ *   a negative error if reclaim has to deal with it itself.
+ */
+int bdi_start_inode_writeback(struct inode *inode, pgoff_t offset)
+{
+	struct backing_dev_info *bdi = inode_to_bdi(inode);
+	struct wb_writeback_work *work;
+	int lookup = 0;
+
+	spin_lock_bh(&bdi->wb_lock);
+	list_for_each_entry_reverse(work, &bdi->work_list, list) {
+		if (work->for_reclaim && work->inode == inode &&
+		    reclaim_work_extend(work, offset)) {
+			spin_unlock_bh(&bdi->wb_lock);
+			return 0;
+		}
+		if (++lookup == RECLAIM_WB_LOOKUP)
+			break;
+	}
+	spin_unlock_bh(&bdi->wb_lock);
+
+	work = kzalloc(sizeof(*work),
+		       GFP_NOWAIT | __GFP_NOMEMALLOC | __GFP_NOWARN);
+	if (!work)
+		return -ENOMEM;
+
+	/*
+	 * Don't take an inode reference on a filesystem being unmounted.
+	 * Once queued, umount's sync_filesystem() waits for the work, so
+	 * the reference is dropped before the inodes are evicted.
+	 */
+	if (!pin_sb_for_writeback(inode->i_sb)) {
+		kfree(work);
+		return -ENOENT;
+	}
+	work->inode = igrab(inode);
+	drop_super(inode->i_sb);
+	if (!work->inode) {
+		kfree(work);
+		return -ENOENT;
+	}
+	work->sync_mode = WB_SYNC_NONE;
+	work->for_reclaim = 1;
+	work->offset = offset;
+	work->nr_pages = 1;
+
+	bdi_queue_work(bdi, work);
+	return 0;
+}
+
 /**
  * bdi_start_background_writeback - start background writeback
  * @bdi: the backing device to write from
@@ -470,32 +588,6 @@ writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 	return ret;
 }
 
-/*
- * For background writeback the caller does not have the sb pinned
- * before calling writeback. So make sure that we do pin it, so it doesn't
- * go away while we are writing inodes from it.
- */
-static bool pin_sb_for_writeback(struct super_block *sb)
-{
-	spin_lock(&sb_lock);
-	if (list_empty(&sb->s_instances)) {
-		spin_unlock(&sb_lock);
-		return false;
-	}
-
-	sb->s_count++;
-	spin_unlock(&sb_lock);
-
-	if (down_read_trylock(&sb->s_umount)) {
-		if (sb->s_root)
-			return true;
-		up_read(&sb->s_umount);
-	}
-
-	put_super(sb);
-	return false;
-}
-
 /*
  * Write a portion of b_io inodes which belong to @sb.
  *
@@ -788,6 +880,37 @@ get_next_work_item(struct backing_dev_info *bdi)
 	return work;
 }
 
+/*
+ * Write the range of an inode queued by bdi_start_inode_writeback().
+ * The work is dropped if the filesystem is being unmounted or remounted.
+ */
+static long wb_writeback_reclaim(struct wb_writeback_work *work)
+{
+	struct super_block *sb = work->inode->i_sb;
+	struct address_space *mapping = work->inode->i_mapping;
+	struct writeback_control wbc = {
+		.sync_mode	= WB_SYNC_NONE,
+		.nr_to_write	= work->nr_pages,
+		.range_start	= (loff_t)work->offset << PAGE_CACHE_SHIFT,
+		.range_end	= ((loff_t)(work->offset + work->nr_pages)
+				   << PAGE_CACHE_SHIFT) - 1,
+	};
+	long wrote = 0;
+
+	if (!pin_sb_for_writeback(sb))
+		goto out;
+	if (mapping_cap_writeback_dirty(mapping)) {
+		do_writepages(mapping, &wbc);
+		wrote = work->nr_pages - wbc.nr_to_write;
+		count_vm_event(PGRECLAIM_WB_CLUSTERS);
+		count_vm_events(PGRECLAIM_WB_PAGES, wrote);
+	}
+	drop_super(sb);
+out:
+	iput(work->inode);
+	return wrote;
+}
+
 /*
  * Add in the number of potentially dirty inodes, because each inode
  * write can dirty pagecache in the underlying blockdev.
@@ -869,7 +992,10 @@ long wb_do_writeback(struct bdi_writeback *wb, int force_wait)
 
 		trace_writeback_exec(bdi, work);
 
-		wrote += wb_writeback(wb, work);
+		if (work->for_reclaim)
+			wrote += wb_writeback_reclaim(work);
+		else
+			wrote += wb_writeback(wb, work);
 
 		/*
 		 * Notify the caller of completion if this is a synchronous
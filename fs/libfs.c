@@ -625,6 +625,62 @@ ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos,
 	return count;
 }
 
+/**
+ * simple_write_lines - hand the lines written from user space to a parser
+ * @from: the user space buffer to read from
+ * @count: the number of bytes to read
+ * @parse: called on each non-empty line, NUL-terminated and without its
+ *	newline; returns zero or a negative error
+ * @data: passed to @parse
+ *
+ * The simple_write_lines() function reads up to a page from @from and
+ * feeds it to @parse line by line.  A line cut at the end of the page
+ * is left unconsumed: the short write makes the writer send it again
+ * together with the rest.  The last line of the input may lack its
+ * newline.
+ *
+ * On success, the number of bytes consumed is returned.  Otherwise the
+ * first error from @parse is returned, or -EINVAL if not even one line
+ * fits in a page.
+ **/
+ssize_t simple_write_lines(const char __user *from, size_t count,
+		int (*parse)(char *line, void *data), void *data)
+{
+	size_t len = min_t(size_t, count, PAGE_SIZE - 1);
+	char *buf, *line, *eol;
+	ssize_t ret;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, from, len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[len] = '\0';
+
+	for (line = buf; line < buf + len; line = eol + 1) {
+		eol = strchr(line, '\n');
+		if (!eol) {
+			if (line > buf || len < count)
+				break;
+			eol = buf + len;
+		}
+		*eol = '\0';
+		if (*line) {
+			ret = parse(line, data);
+			if (ret)
+				goto out;
+		}
+	}
+	ret = min_t(size_t, line - buf, len);
+	if (!ret)
+		ret = -EINVAL;
+out:
+	free_page((unsigned long)buf);
+	return ret;
+}
+
 /**
  * memory_read_from_buffer - copy data from the buffer
  * @to: the kernel space buffer to read to
@@ -986,6 +1042,7 @@ EXPORT_SYMBOL(noop_fsync);
 EXPORT_SYMBOL(simple_unlink);
 EXPORT_SYMBOL(simple_read_from_buffer);
 EXPORT_SYMBOL(simple_write_to_buffer);
+EXPORT_SYMBOL(simple_write_lines);
 EXPORT_SYMBOL(memory_read_from_buffer);
 EXPORT_SYMBOL(simple_transaction_set);
 EXPORT_SYMBOL(simple_transaction_get);
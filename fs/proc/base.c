@@ -1062,6 +1062,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	/* Move the process in the low memory killer's index */
+	lowmem_adj_update(task);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1197,6 +1199,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	/* Move the process in the low memory killer's index */
+	lowmem_adj_update(task);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -156,6 +156,10 @@ static inline void pmdp_set_wrprotect(struct mm_struct *mm,
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 #endif
 
+#ifndef update_mmu_cache_pmd
+#define update_mmu_cache_pmd(vma, address, pmdp)	do { } while (0)
+#endif
+
 #ifndef __HAVE_ARCH_PMDP_SPLITTING_FLUSH
 extern pmd_t pmdp_splitting_flush(struct vm_area_struct *vma,
 				  unsigned long address,
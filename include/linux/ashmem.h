@@ -32,6 +32,16 @@ struct ashmem_pin {
 	__u32 len;	/* length forward from offset, in bytes, page-aligned */
 };
 
+/*
+ * Pin or unpin 'nr' ranges of one region in one call. 'ranges' points to an
+ * array of struct ashmem_pin; 'op' is ASHMEM_PIN or ASHMEM_UNPIN.
+ */
+struct ashmem_pin_batch {
+	__u32 op;	/* ASHMEM_PIN or ASHMEM_UNPIN */
+	__u32 nr;	/* number of ranges, at most 256 */
+	__u64 ranges;	/* user pointer to the struct ashmem_pin array */
+};
+
 #define __ASHMEMIOC		0x77
 
 #define ASHMEM_SET_NAME		_IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
@@ -44,5 +54,6 @@ struct ashmem_pin {
 #define ASHMEM_UNPIN		_IOW(__ASHMEMIOC, 8, struct ashmem_pin)
 #define ASHMEM_GET_PIN_STATUS	_IO(__ASHMEMIOC, 9)
 #define ASHMEM_PURGE_ALL_CACHES	_IO(__ASHMEMIOC, 10)
+#define ASHMEM_PIN_BATCH	_IOW(__ASHMEMIOC, 11, struct ashmem_pin_batch)
 
 #endif	/* _LINUX_ASHMEM_H */
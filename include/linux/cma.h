@@ -223,6 +223,11 @@ struct cma_allocator;
  *		this region is converted from early to normal.  Early.
  *		Private.
  * @free_alloc_name:	Whether @alloc_name was kmalloced().  Private.
+ * @migratable:	Whether the region should be lent to movable page
+ *		allocations while its space is not allocated.  Needs
+ *		CONFIG_CMA_MIGRATE.  Early.
+ * @lent:	Whether the region's free space is in use by the page
+ *		allocator.  Read only.
  *
  * Regions come in two types: an early region and normal region.  The
  * former can be reserved or not-reserved.  Fields marked as "early"
@@ -263,6 +268,8 @@ struct cma_region {
 	unsigned reserved:1;
 	unsigned copy_name:1;
 	unsigned free_alloc_name:1;
+	unsigned migratable:1;
+	unsigned lent:1;
 };
 
 
@@ -420,6 +427,14 @@ int __init cma_set_defaults(struct cma_region *regions, const char *map);
  */
 extern struct list_head cma_early_regions __initdata;
 
+/*
+ * Migratable regions are aligned to, and sized in multiples of, this
+ * many bytes by cma_early_region_register().
+ */
+#define CMA_MIGRATE_ALIGN						\
+	((dma_addr_t)PAGE_SIZE <<					\
+	 max_t(unsigned, MAX_ORDER - 1, pageblock_order))
+
 
 /**
  * cma_early_region_register() - registers an early region.
@@ -19,7 +19,11 @@ extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 
+extern int sysctl_compaction_proactive_threshold;
+
 extern int fragmentation_index(struct zone *zone, unsigned int order);
+extern int fragmentation_index_reserve(struct zone *zone, unsigned int order,
+				       unsigned long reserve);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask,
 			bool sync);
@@ -27,6 +31,20 @@ extern unsigned long compaction_suitable(struct zone *zone, int order);
 extern unsigned long compact_zone_order(struct zone *zone, int order,
 					gfp_t gfp_mask, bool sync);
 
+extern int kcompactd_run(int nid);
+extern void kcompactd_stop(int nid);
+extern void __wakeup_kcompactd(struct zone *zone, int order);
+
+/* Orders kcompactd keeps a reserve of, those drivers ask for most */
+#define KCOMPACTD_MIN_ORDER	2
+#define KCOMPACTD_MAX_ORDER	4
+
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+	if (order >= KCOMPACTD_MIN_ORDER && order <= KCOMPACTD_MAX_ORDER)
+		__wakeup_kcompactd(zone, order);
+}
+
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -84,6 +102,19 @@ static inline bool compaction_deferred(struct zone *zone)
 	return 1;
 }
 
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop(int nid)
+{
+}
+
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+}
+
 #endif /* CONFIG_COMPACTION */
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
@@ -48,6 +48,31 @@ static inline int cpufreq_unregister_notifier(struct notifier_block *nb,
 }
 #endif		/* CONFIG_CPU_FREQ */
 
+/*
+ * Boost requests: something the user is waiting for is about to run, e.g.
+ * a touch was just reported.  Governors that honour them register on
+ * this chain, which is called in atomic context.
+ */
+#define CPUFREQ_BOOST_PULSE		(0)
+
+#ifdef CONFIG_CPU_FREQ
+int cpufreq_register_boost_notifier(struct notifier_block *nb);
+int cpufreq_unregister_boost_notifier(struct notifier_block *nb);
+void cpufreq_boost_pulse(void);
+#else		/* CONFIG_CPU_FREQ */
+static inline int cpufreq_register_boost_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int cpufreq_unregister_boost_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline void cpufreq_boost_pulse(void)
+{
+}
+#endif		/* CONFIG_CPU_FREQ */
+
 /* if (cpufreq_driver->target) exists, the ->governor decides what frequency
  * within the limits is used. If (cpufreq_driver->setpolicy> exists, these
  * two generic policies are available:
@@ -361,6 +386,9 @@ extern struct cpufreq_governor cpufreq_gov_conservative;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE)
 extern struct cpufreq_governor cpufreq_gov_interactive;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_interactive)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED)
+extern struct cpufreq_governor cpufreq_gov_sched;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
 #endif
 
 
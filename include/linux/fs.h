@@ -920,6 +920,12 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	/* Adaptive readahead history, see mm/readahead.c */
+	pgoff_t win_start;		/* pages read ahead not yet judged */
+	unsigned int win_size;
+	unsigned int hits;		/* pages read ahead and used */
+	unsigned int misses;		/* pages read ahead and not used */
 };
 
 /*
@@ -2470,6 +2476,8 @@ extern ssize_t simple_read_from_buffer(void __user *to, size_t count,
 			loff_t *ppos, const void *from, size_t available);
 extern ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos,
 		const void __user *from, size_t count);
+extern ssize_t simple_write_lines(const char __user *from, size_t count,
+		int (*parse)(char *line, void *data), void *data);
 
 extern int generic_file_fsync(struct file *, int);
 
@@ -0,0 +1,46 @@
+#ifndef __LZ4_H__
+#define __LZ4_H__
+/*
+ * LZ4 Kernel Interface
+ *
+ * A fast byte-oriented LZ77 compressor producing the LZ4 block
+ * format. It trades some compression ratio against LZO for lower
+ * compression and decompression cost.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define LZ4_MEM_COMPRESS	(4096 * sizeof(unsigned char *))
+
+#define lz4_compressbound(isize)	((isize) + ((isize) / 255) + 16)
+
+/*
+ * lz4_compress()
+ *	src     : source address of the original data
+ *	src_len : size of the original data
+ *	dst	: output buffer address of the compressed data
+ *	dst_len : in: size of the output buffer, which should be at
+ *		  least lz4_compressbound(src_len) to never fail;
+ *		  out: size of the compressed data
+ *	wrkmem  : address of the working memory, LZ4_MEM_COMPRESS bytes
+ *	return  : 0 on success, -1 if the output buffer is too small
+ */
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem);
+
+/*
+ * lz4_decompress_unknownoutputsize()
+ *	src     : source address of the compressed data
+ *	src_len : size of the compressed data
+ *	dest	: output buffer address of the decompressed data
+ *	dest_len: in: size of the output buffer;
+ *		  out: size of the decompressed data
+ *	return  : 0 on success, -1 on malformed input or if the output
+ *		  buffer is too small. Never reads or writes out of bounds.
+ */
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len);
+
+#endif
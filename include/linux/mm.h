@@ -1492,6 +1492,9 @@ unsigned long max_sane_readahead(unsigned long nr);
 unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
+unsigned long ra_adapt_max(struct address_space *mapping,
+			   struct file_ra_state *ra,
+			   pgoff_t offset, unsigned long max);
 
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
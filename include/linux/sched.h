@@ -1166,6 +1166,19 @@ struct sched_statistics {
 };
 #endif
 
+#ifdef CONFIG_SCHED_ENERGY
+/*
+ * Share of its time a task spends running, out of SCHED_POWER_SCALE,
+ * sampled each time it goes to sleep.
+ */
+struct sched_task_util {
+	u64			sample_start;
+	u64			sample_exec;
+	unsigned long		avg;
+	unsigned long		queued;		/* avg, as counted in the rq */
+};
+#endif
+
 struct sched_entity {
 	struct load_weight	load;		/* for load-balancing */
 	struct rb_node		run_node;
@@ -1183,6 +1196,10 @@ struct sched_entity {
 	struct sched_statistics statistics;
 #endif
 
+#ifdef CONFIG_SCHED_ENERGY
+	struct sched_task_util	util;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct sched_entity	*parent;
 	/* rq on which this entity is (to be) queued: */
@@ -1280,6 +1297,11 @@ struct task_struct {
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+	/* Thread group leaders only, see lowmemorykiller.c */
+	struct rb_node lowmem_adj_node;
+	int lowmem_adj;		/* oom_adj it is indexed under */
+#endif
 
 	struct mm_struct *mm, *active_mm;
 #ifdef CONFIG_COMPAT_BRK
@@ -1963,6 +1985,50 @@ extern void wake_up_idle_cpu(int cpu);
 static inline void wake_up_idle_cpu(int cpu) { }
 #endif
 
+#ifdef CONFIG_CPU_FREQ
+/*
+ * Called by the scheduler with the runqueue of @cpu locked, whenever its
+ * utilization is worked out again: at enqueue, dequeue and tick.  @util
+ * is out of @max, @time is the runqueue clock in nanoseconds.
+ */
+struct update_util_data {
+	void (*func)(struct update_util_data *data, int cpu, u64 time,
+		     unsigned long util, unsigned long max);
+};
+
+extern void cpufreq_set_update_util_data(int cpu,
+					 struct update_util_data *data);
+#endif
+
+#ifdef CONFIG_SCHED_ENERGY
+/*
+ * Energy model of a platform's cpus, for energy-aware task placement.
+ * Capacity is out of SCHED_POWER_SCALE, power is in mW for one cpu.
+ */
+struct sched_cap_state {
+	unsigned long cap;		/* compute capacity at this OPP */
+	unsigned long power;		/* power when busy at this OPP */
+};
+
+struct sched_idle_state {
+	unsigned long power;		/* power in this idle state */
+};
+
+struct sched_energy_model {
+	/* By increasing capacity, the last at SCHED_POWER_SCALE */
+	const struct sched_cap_state *cap_states;
+	int nr_cap_states;
+	/* From the shallowest to the deepest */
+	const struct sched_idle_state *idle_states;
+	int nr_idle_states;
+	/* All cpus run at the same OPP */
+	bool shared_clock;
+};
+
+extern unsigned int sysctl_sched_energy_aware;
+extern int sched_energy_register(const struct sched_energy_model *model);
+#endif
+
 extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
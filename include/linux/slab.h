@@ -106,6 +106,15 @@ int kmem_cache_shrink(struct kmem_cache *);
 void kmem_cache_free(struct kmem_cache *, void *);
 unsigned int kmem_cache_size(struct kmem_cache *);
 
+/*
+ * Allocate or free several objects of a cache at once.  The objects go
+ * to or come from the array; kmem_cache_alloc_bulk() returns the number
+ * allocated, which is either all of them or 0.  Cheaper than calling
+ * kmem_cache_alloc()/kmem_cache_free() in a loop for bursts of objects.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+void kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
+
 /*
  * Please use this macro to create slab caches. Simply specify the
  * name of the structure and maybe some flags that are listed above.
@@ -17,6 +17,7 @@
 #define _LINUX_WAKELOCK_H
 
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/ktime.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
@@ -34,7 +35,9 @@ enum {
 
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
-	struct list_head    link;
+	struct list_head    link;	/* all wake locks */
+	struct list_head    active;	/* held without a timeout */
+	struct rb_node      node;	/* held with a timeout, by expiry */
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
@@ -47,6 +50,7 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		ktime_t         sleep_wait_start;
 	} stat;
 #endif
 #endif
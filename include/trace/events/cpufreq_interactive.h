@@ -0,0 +1,99 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_interactive
+
+#if !defined(_TRACE_CPUFREQ_INTERACTIVE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_INTERACTIVE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpufreq_interactive_target,
+
+	TP_PROTO(unsigned int cpu, unsigned int load,
+		unsigned int curtarg, unsigned int targ),
+
+	TP_ARGS(cpu, load, curtarg, targ),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, cpu)
+		__field(unsigned int, load)
+		__field(unsigned int, curtarg)
+		__field(unsigned int, targ)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->load = load;
+		__entry->curtarg = curtarg;
+		__entry->targ = targ;
+	),
+
+	TP_printk("cpu=%u load=%u cur=%u targ=%u",
+		__entry->cpu,
+		__entry->load,
+		__entry->curtarg,
+		__entry->targ)
+);
+
+DECLARE_EVENT_CLASS(cpufreq_interactive_set_template,
+
+	TP_PROTO(unsigned int cpu, unsigned int targ, unsigned int actual),
+
+	TP_ARGS(cpu, targ, actual),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, cpu)
+		__field(unsigned int, targ)
+		__field(unsigned int, actual)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->targ = targ;
+		__entry->actual = actual;
+	),
+
+	TP_printk("cpu=%u targ=%u actual=%u",
+		__entry->cpu,
+		__entry->targ,
+		__entry->actual)
+);
+
+DEFINE_EVENT(cpufreq_interactive_set_template, cpufreq_interactive_up,
+
+	TP_PROTO(unsigned int cpu, unsigned int targ, unsigned int actual),
+
+	TP_ARGS(cpu, targ, actual)
+);
+
+DEFINE_EVENT(cpufreq_interactive_set_template, cpufreq_interactive_down,
+
+	TP_PROTO(unsigned int cpu, unsigned int targ, unsigned int actual),
+
+	TP_ARGS(cpu, targ, actual)
+);
+
+TRACE_EVENT(cpufreq_interactive_boost,
+
+	TP_PROTO(unsigned int floor, unsigned long duration),
+
+	TP_ARGS(floor, duration),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, floor)
+		__field(unsigned long, duration)
+	),
+
+	TP_fast_assign(
+		__entry->floor = floor;
+		__entry->duration = duration;
+	),
+
+	TP_printk("floor=%u duration=%lu",
+		__entry->floor,
+		__entry->duration)
+);
+
+#endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -114,6 +114,15 @@ bool irq_work_queue(struct irq_work *entry)
 }
 EXPORT_SYMBOL_GPL(irq_work_queue);
 
+/*
+ * Whether this cpu has entries queued.  Without a self-interrupt they
+ * only run from the tick, which must then not be stopped.
+ */
+bool irq_work_needs_cpu(void)
+{
+	return this_cpu_read(irq_work_list) != NULL;
+}
+
 /*
  * Run the irq_work entries on this cpu. Requires to be ran from hardirq
  * context with local IRQs disabled.
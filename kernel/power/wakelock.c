@@ -38,11 +38,26 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_INITIALIZED            (1U << 8)
 #define WAKE_LOCK_ACTIVE                 (1U << 9)
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
-#define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * Active wake locks of each type, under a lock of their own so that the
+ * idle and suspend paths do not contend.  Locks held without a timeout
+ * are on a list; whether there are any is all that matters.  Those with
+ * a timeout are in a tree ordered by expiry: the first to expire is the
+ * leftmost and the last the rightmost, so checking for active locks does
+ * not have to walk them all.
+ */
+static struct {
+	spinlock_t lock;
+	struct list_head untimed;
+	struct rb_root timed;
+} active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+
+/* All wake locks, for the stats; not used to lock or unlock */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static LIST_HEAD(wake_locks);
+
+/* These are protected by the WAKE_LOCK_SUSPEND lock */
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -51,9 +66,39 @@ static struct wake_lock unknown_wakeup;
 
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Time spent waiting to suspend, that is with main_wake_lock released,
+ * up to last_sleep_time_update.  A suspend lock was preventing suspend
+ * for as long as this grew while it was held, which is what its
+ * prevent_suspend_time counts.
+ */
+static ktime_t sleep_wait_total;
+static ktime_t last_sleep_time_update;
+static bool sleep_waiting;
+
+static ktime_t sleep_wait_time(ktime_t now)
+{
+	if (!sleep_waiting || now.tv64 < last_sleep_time_update.tv64)
+		return sleep_wait_total;
+	return ktime_add(sleep_wait_total,
+			 ktime_sub(now, last_sleep_time_update));
+}
+
+/*
+ * Called with the suspend lock held, after expiring the suspend locks
+ * that are due, so that their time is counted up to their expiry.
+ */
+static void update_sleep_wait_stats_locked(int done)
+{
+	ktime_t now = ktime_get();
+
+	sleep_wait_total = sleep_wait_time(now);
+	last_sleep_time_update = now;
+	sleep_waiting = !done;
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -76,7 +121,7 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 	return 1;
 }
 
-
+/* Called with the lock of the wake lock's type held */
 static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 {
 	int lock_count = lock->stat.count;
@@ -98,9 +143,10 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		else
 			expire_count++;
 		total_time = ktime_add(total_time, add_time);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND)
 			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+					ktime_sub(sleep_wait_time(now),
+						  lock->stat.sleep_wait_start));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -118,18 +164,19 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 {
 	unsigned long irqflags;
 	struct wake_lock *lock;
+	spinlock_t *type_lock;
 	int ret;
-	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
 			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
+	list_for_each_entry(lock, &wake_locks, link) {
+		type_lock = &active_wake_locks[lock->flags &
+					       WAKE_LOCK_TYPE_MASK].lock;
+		spin_lock(type_lock);
 		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+		spin_unlock(type_lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
@@ -153,105 +200,123 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND) {
+		duration = ktime_sub(sleep_wait_time(now),
+				     lock->stat.sleep_wait_start);
 		lock->stat.prevent_suspend_time = ktime_add(
 			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void wake_lock_stat_start_locked(struct wake_lock *lock)
 {
-	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
-	last_sleep_time_update = now;
+	lock->stat.last_time = ktime_get();
+	lock->stat.sleep_wait_start = sleep_wait_time(lock->stat.last_time);
 }
 #endif
 
+/* Take an active lock off the list or tree of its type */
+static void wake_lock_dequeue(struct wake_lock *lock, int type)
+{
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		rb_erase(&lock->node, &active_wake_locks[type].timed);
+	else
+		list_del_init(&lock->active);
+}
+
+static void wake_lock_enqueue_timed(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &active_wake_locks[type].timed.rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *entry;
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct wake_lock, node);
+		if (time_before(lock->expires, entry->expires))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&lock->node, parent, p);
+	rb_insert_color(&lock->node, &active_wake_locks[type].timed);
+}
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	wake_lock_dequeue(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
 
-/* Caller must acquire the list_lock spinlock */
+/* Caller must hold the lock of the type */
+static void expire_wake_locks_locked(int type)
+{
+	struct rb_node *n;
+	struct wake_lock *lock;
+
+	while ((n = rb_first(&active_wake_locks[type].timed))) {
+		lock = rb_entry(n, struct wake_lock, node);
+		if (time_after(lock->expires, jiffies))
+			break;
+		expire_wake_lock(lock);
+	}
+}
+
+/* Caller must hold the lock of the type */
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
+	struct rb_node *n;
 	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+	list_for_each_entry(lock, &active_wake_locks[type].untimed, active) {
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			print_expired = false;
+	}
+	for (n = rb_first(&active_wake_locks[type].timed); n; n = rb_next(n)) {
+		long timeout;
+
+		lock = rb_entry(n, struct wake_lock, node);
+		timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct rb_node *last;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
-	}
-	return max_timeout;
+	expire_wake_locks_locked(type);
+	if (!list_empty(&active_wake_locks[type].untimed))
+		return -1;
+	/* All those left expire after jiffies, the last one latest */
+	last = rb_last(&active_wake_locks[type].timed);
+	if (!last)
+		return 0;
+	return rb_entry(last, struct wake_lock, node)->expires - jiffies;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&active_wake_locks[type].lock, irqflags);
 	ret = has_wake_lock_locked(type);
 	if (ret && (debug_mask & DEBUG_WAKEUP) && type == WAKE_LOCK_SUSPEND)
 		print_active_locks(type);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_wake_locks[type].lock, irqflags);
 	return ret;
 }
 
@@ -295,7 +360,7 @@ static void expire_wake_locks(unsigned long data)
 	unsigned long irqflags;
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: start\n");
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&active_wake_locks[WAKE_LOCK_SUSPEND].lock, irqflags);
 	if (debug_mask & DEBUG_SUSPEND)
 		print_active_locks(WAKE_LOCK_SUSPEND);
 	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
@@ -303,7 +368,8 @@ static void expire_wake_locks(unsigned long data)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_wake_locks[WAKE_LOCK_SUSPEND].lock,
+			       irqflags);
 }
 static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
@@ -352,21 +418,36 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	INIT_LIST_HEAD(&lock->active);
+	RB_CLEAR_NODE(&lock->node);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
 
 void wake_lock_destroy(struct wake_lock *lock)
 {
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	unsigned long irqflags;
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
+	list_del(&lock->link);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	spin_lock_irqsave(&active_wake_locks[type].lock, irqflags);
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	if (lock->flags & WAKE_LOCK_ACTIVE) {
+		wake_lock_dequeue(lock, type);
+		lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
+	}
+	spin_unlock_irqrestore(&active_wake_locks[type].lock, irqflags);
+
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
+		spin_lock_irqsave(&active_wake_locks[WAKE_LOCK_SUSPEND].lock,
+				  irqflags);
 		deleted_wake_locks.stat.count += lock->stat.count;
 		deleted_wake_locks.stat.expire_count += lock->stat.expire_count;
 		deleted_wake_locks.stat.total_time =
@@ -378,10 +459,10 @@ void wake_lock_destroy(struct wake_lock *lock)
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
+		spin_unlock_irqrestore(
+			&active_wake_locks[WAKE_LOCK_SUSPEND].lock, irqflags);
 	}
 #endif
-	list_del(&lock->link);
-	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
@@ -392,9 +473,9 @@ static void wake_lock_internal(
 	unsigned long irqflags;
 	long expire_in;
 
-	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	spin_lock_irqsave(&active_wake_locks[type].lock, irqflags);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
 #ifdef CONFIG_WAKELOCK_STAT
 	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
@@ -406,16 +487,16 @@ static void wake_lock_internal(
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
 	    (long)(lock->expires - jiffies) <= 0) {
 		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start_locked(lock);
 	}
 #endif
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+		wake_lock_stat_start_locked(lock);
 #endif
-	}
-	list_del(&lock->link);
+	} else
+		wake_lock_dequeue(lock, type);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
@@ -423,21 +504,21 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		wake_lock_enqueue_timed(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		list_add(&lock->active, &active_wake_locks[type].untimed);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
-		if (lock == &main_wake_lock)
+		if (lock == &main_wake_lock) {
+			expire_wake_locks_locked(type);
 			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+		}
 #endif
 		if (has_timeout)
 			expire_in = has_wake_lock_locked(type);
@@ -457,7 +538,7 @@ static void wake_lock_internal(
 				queue_work(suspend_work_queue, &suspend_work);
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_wake_locks[type].lock, irqflags);
 }
 
 void wake_lock(struct wake_lock *lock)
@@ -476,16 +557,16 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
+	spin_lock_irqsave(&active_wake_locks[type].lock, irqflags);
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	if (lock->flags & WAKE_LOCK_ACTIVE)
+		wake_lock_dequeue(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
 		if (has_lock > 0) {
@@ -509,7 +590,7 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&active_wake_locks[type].lock, irqflags);
 }
 EXPORT_SYMBOL(wake_unlock);
 
@@ -537,8 +618,11 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
+		spin_lock_init(&active_wake_locks[i].lock);
+		INIT_LIST_HEAD(&active_wake_locks[i].untimed);
+		active_wake_locks[i].timed = RB_ROOT;
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -530,6 +530,19 @@ struct rq {
 	u64 prev_irq_time;
 #endif
 
+#ifdef CONFIG_CPU_FREQ
+	/* Share of time the cpu is busy, decaying average for cpufreq */
+	unsigned long util_avg;
+	u64 util_period_start;
+	u64 util_last_update;
+	u64 util_busy;
+#endif
+
+#ifdef CONFIG_SCHED_ENERGY
+	/* Sum of the utilization of the cfs tasks queued, for placement */
+	unsigned long util_queued;
+#endif
+
 	/* calc_load related fields */
 	unsigned long calc_load_update;
 	long calc_load_active;
@@ -1757,6 +1770,7 @@ static void calc_load_account_idle(struct rq *this_rq);
 static void update_sysctl(void);
 static int get_update_sysctl_factor(void);
 static void update_cpu_load(struct rq *this_rq);
+static void update_rq_util(struct rq *rq);
 
 static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
 {
@@ -1811,6 +1825,7 @@ static void set_load_weight(struct task_struct *p)
 static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
+	update_rq_util(rq);
 	sched_info_queued(p);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
@@ -1818,6 +1833,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
+	update_rq_util(rq);
 	sched_info_dequeued(p);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
@@ -2028,6 +2044,7 @@ static void update_rq_clock_task(struct rq *rq, s64 delta)
 #endif /* CONFIG_IRQ_TIME_ACCOUNTING */
 
 #include "sched_idletask.c"
+#include "sched_energy.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
 #include "sched_autogroup.c"
@@ -2813,6 +2830,8 @@ static void __sched_fork(struct task_struct *p)
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
 
+	energy_task_fork(p);
+
 	INIT_LIST_HEAD(&p->rt.run_list);
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -3628,6 +3647,125 @@ static void update_cpu_load_active(struct rq *this_rq)
 	calc_load_account_active(this_rq);
 }
 
+#ifdef CONFIG_CPU_FREQ
+/*
+ * Utilization for cpufreq governors: the share of time the cpu is busy,
+ * out of SCHED_POWER_SCALE, as an average over periods of about 1ms
+ * (2^20ns) that decays by half every 4 periods.  That follows a change
+ * of load within a few milliseconds, without the sampling timers that
+ * would keep an idle cpu awake.
+ *
+ * It is updated whenever a task is enqueued or dequeued and at each tick,
+ * right after the runqueue clock.  The time since the previous update was
+ * spent busy if a task other than idle is current: a task going to sleep
+ * is dequeued before it switches to idle, and a task waking up on an idle
+ * cpu is enqueued before idle switches to it.
+ */
+#define UTIL_PERIOD_SHIFT	20
+#define UTIL_PERIOD		(1ULL << UTIL_PERIOD_SHIFT)
+#define UTIL_HALFLIFE		4
+
+/* y^n * 2^32 for n < UTIL_HALFLIFE, where y^UTIL_HALFLIFE = 1/2 */
+static const u32 util_decay_inv[UTIL_HALFLIFE] = {
+	0xffffffff, 0xd744fccb, 0xb504f334, 0x9837f052,
+};
+
+static unsigned long util_decay(unsigned long val, u64 periods)
+{
+	if (periods >= UTIL_HALFLIFE * (SCHED_POWER_SHIFT + 1))
+		return 0;
+
+	val >>= (unsigned int)periods / UTIL_HALFLIFE;
+	return ((u64)val * util_decay_inv[(unsigned int)periods %
+					  UTIL_HALFLIFE]) >> 32;
+}
+
+DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_set_update_util_data - set or clear a cpu's utilization hook
+ * @cpu: cpu to set the hook for
+ * @data: hook, or NULL to remove it
+ *
+ * After clearing, synchronize_sched() waits for calls in progress.
+ */
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data)
+{
+	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), data);
+}
+EXPORT_SYMBOL_GPL(cpufreq_set_update_util_data);
+
+static void update_rq_util(struct rq *rq)
+{
+	struct update_util_data *data;
+	u64 now = rq->clock_task;
+	u64 end, periods;
+	unsigned long util, busy_util;
+	int busy = rq->curr != rq->idle;
+
+	end = rq->util_period_start + UTIL_PERIOD;
+	if (now < end) {
+		if (busy)
+			rq->util_busy += now - rq->util_last_update;
+		rq->util_last_update = now;
+		goto out;
+	}
+
+	/* Fold the period in progress into the average */
+	if (busy)
+		rq->util_busy += end - rq->util_last_update;
+	busy_util = min_t(u64, rq->util_busy >>
+			  (UTIL_PERIOD_SHIFT - SCHED_POWER_SHIFT),
+			  SCHED_POWER_SCALE);
+	util = util_decay(rq->util_avg, 1) +
+	       busy_util - util_decay(busy_util, 1);
+
+	/* Whole periods since then were all busy or all idle */
+	periods = (now - end) >> UTIL_PERIOD_SHIFT;
+	if (busy)
+		util = SCHED_POWER_SCALE -
+		       util_decay(SCHED_POWER_SCALE - util, periods);
+	else
+		util = util_decay(util, periods);
+
+	rq->util_avg = util;
+	rq->util_period_start = end + (periods << UTIL_PERIOD_SHIFT);
+	rq->util_busy = busy ? now - rq->util_period_start : 0;
+	rq->util_last_update = now;
+
+out:
+	data = rcu_dereference_sched(per_cpu(cpufreq_update_util_data,
+					     cpu_of(rq)));
+	if (!data)
+		return;
+
+	/* Real-time tasks cannot wait for the average to catch up */
+	util = rq->rt.rt_nr_running ? SCHED_POWER_SCALE : rq->util_avg;
+	data->func(data, cpu_of(rq), now, util, SCHED_POWER_SCALE);
+}
+
+#ifdef CONFIG_SCHED_ENERGY
+/*
+ * rq->util_avg as it would be at @now, for a cpu that has been idle since
+ * its last update: with the tick stopped, nothing folds the idle periods
+ * in until the next enqueue.
+ */
+static unsigned long rq_util_idle(struct rq *rq, u64 now)
+{
+	u64 last = ACCESS_ONCE(rq->util_last_update);
+	unsigned long util = ACCESS_ONCE(rq->util_avg);
+
+	if ((s64)(now - last) <= 0)
+		return util;
+	return util_decay(util, (now - last) >> UTIL_PERIOD_SHIFT);
+}
+#endif
+#else
+static inline void update_rq_util(struct rq *rq)
+{
+}
+#endif /* CONFIG_CPU_FREQ */
+
 #ifdef CONFIG_SMP
 
 /*
@@ -4073,6 +4211,7 @@ void scheduler_tick(void)
 
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
+	update_rq_util(rq);
 	update_cpu_load_active(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
@@ -0,0 +1,689 @@
+#ifdef CONFIG_SCHED_ENERGY
+
+/*
+ * Energy-aware task placement.
+ *
+ * A platform registers an energy model: the capacity and busy power of
+ * its cpus at each OPP, and their power in each idle state.  A waking
+ * task then goes to the cpu where the model says that it adds the least
+ * power, among those where it fits: light tasks end up packed on cpus
+ * that are busy anyway, and the others stay in their deepest idle state,
+ * while heavy tasks raise the OPP less when spread.  The utilization of
+ * a cpu is the rq->util_avg the cpufreq 'sched' governor follows.
+ *
+ * A cpu with tasks is taken to spend its idle time in the shallowest
+ * state, between them, and a cpu without any in the deepest.  That is
+ * where the cost of waking a second core for a light task comes from.
+ *
+ * An idle cpu may have stopped its tick, leaving rq->util_avg as it was
+ * when the cpu went idle; its utilization is decayed over the time since.
+ */
+
+/* 1.25, out of SCHED_POWER_SCALE: the margin the 'sched' governor uses */
+#define ENERGY_CAPACITY_MARGIN	1280
+
+/* Enough for the SoCs this is meant for; the cpus fit in a long */
+#define ENERGY_MAX_CPUS		8
+
+/* Samples of task utilization are taken over at least this long */
+#define TASK_UTIL_MIN_PERIOD	(4 * NSEC_PER_MSEC)
+
+unsigned int sysctl_sched_energy_aware = 1;
+
+static const struct sched_energy_model *sched_energy;
+
+static unsigned long util_decay(unsigned long val, u64 periods);
+static unsigned long rq_util_idle(struct rq *rq, u64 now);
+
+/**
+ * sched_energy_register - set the energy model of the platform
+ * @model: the model, which must stay around
+ *
+ * Meant to be called once, from the platform's initcalls.
+ */
+int sched_energy_register(const struct sched_energy_model *model)
+{
+	int i;
+
+	if (nr_cpu_ids > ENERGY_MAX_CPUS || model->nr_cap_states < 1 ||
+	    model->nr_idle_states < 1)
+		return -EINVAL;
+	for (i = 1; i < model->nr_cap_states; i++)
+		if (model->cap_states[i].cap <= model->cap_states[i - 1].cap)
+			return -EINVAL;
+	if (model->cap_states[model->nr_cap_states - 1].cap !=
+	    SCHED_POWER_SCALE)
+		return -EINVAL;
+
+	smp_wmb();
+	sched_energy = model;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sched_energy_register);
+
+static inline const struct sched_energy_model *energy_model(void)
+{
+	if (!sysctl_sched_energy_aware)
+		return NULL;
+	return ACCESS_ONCE(sched_energy);
+}
+
+static inline bool energy_fits(unsigned long util)
+{
+	return util * ENERGY_CAPACITY_MARGIN <
+	       SCHED_POWER_SCALE * SCHED_POWER_SCALE;
+}
+
+/* The lowest OPP that leaves the margin over @util, as the governor picks */
+static const struct sched_cap_state *
+energy_cap_state(const struct sched_energy_model *em, unsigned long util)
+{
+	int i;
+
+	for (i = 0; i < em->nr_cap_states - 1; i++)
+		if (em->cap_states[i].cap * SCHED_POWER_SCALE >=
+		    util * ENERGY_CAPACITY_MARGIN)
+			break;
+	return &em->cap_states[i];
+}
+
+/*
+ * Power in mW that @nr cpus draw with utilizations @util: the busy
+ * power of their OPP for the share of time the work takes at that OPP,
+ * and the idle power for the rest.
+ */
+static unsigned long energy_power(const struct sched_energy_model *em,
+				  const unsigned long *util, int nr)
+{
+	const struct sched_cap_state *cs = NULL;
+	unsigned long power = 0, busy, idle_power;
+	int i;
+
+	if (em->shared_clock) {
+		unsigned long max_util = 0;
+
+		for (i = 0; i < nr; i++)
+			max_util = max(max_util, util[i]);
+		cs = energy_cap_state(em, max_util);
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (!em->shared_clock)
+			cs = energy_cap_state(em, util[i]);
+		busy = min_t(unsigned long,
+			     util[i] * SCHED_POWER_SCALE / cs->cap,
+			     SCHED_POWER_SCALE);
+		if (util[i])
+			idle_power = em->idle_states[0].power;
+		else
+			idle_power = em->idle_states[em->nr_idle_states - 1].power;
+		power += cs->power * busy +
+			 idle_power * (SCHED_POWER_SCALE - busy);
+	}
+	return power >> SCHED_POWER_SHIFT;
+}
+
+/*
+ * The cpu in @allowed where a task of utilization @task_util adds the
+ * least power, preferring @prev_cpu on a tie, or -1 if it fits nowhere.
+ * @util is left as it was.
+ */
+static int energy_find_cpu(const struct sched_energy_model *em,
+			   unsigned long *util, int nr, unsigned long allowed,
+			   unsigned long task_util, int prev_cpu)
+{
+	unsigned long power, best_power = ULONG_MAX;
+	int i, best = -1;
+
+	for (i = 0; i < nr; i++) {
+		if (!(allowed & (1UL << i)) || !energy_fits(util[i] + task_util))
+			continue;
+
+		util[i] += task_util;
+		power = energy_power(em, util, nr);
+		util[i] -= task_util;
+
+		if (power < best_power ||
+		    (power == best_power && i == prev_cpu)) {
+			best_power = power;
+			best = i;
+		}
+	}
+	return best;
+}
+
+/*
+ * The utilization of @cpu at @now.  Unlocked: on 32-bit a racing update
+ * may tear the timestamp, which only misjudges this one decision.
+ */
+static unsigned long energy_cpu_util(int cpu, u64 now)
+{
+	if (idle_cpu(cpu))
+		return rq_util_idle(cpu_rq(cpu), now);
+	return ACCESS_ONCE(cpu_rq(cpu)->util_avg);
+}
+
+/*
+ * Called from select_task_rq_fair() for a waking task: the cpu to put it
+ * on, or -1 to leave it to the usual balancing.  The utilization of a
+ * cpu counts the tasks queued there at once, which rq->util_avg follows
+ * only a few milliseconds later.
+ */
+static int energy_select_cpu(struct task_struct *p, int prev_cpu)
+{
+	const struct sched_energy_model *em = energy_model();
+	unsigned long util[ENERGY_MAX_CPUS], allowed = 0;
+	unsigned long task_util = p->se.util.avg;
+	u64 now;
+	int cpu;
+
+	if (!em)
+		return -1;
+	smp_rmb();
+
+	now = sched_clock_cpu(smp_processor_id());
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		util[cpu] = 0;
+		if (!cpu_online(cpu))
+			continue;
+		util[cpu] = energy_cpu_util(cpu, now);
+		/* What is left of the task's own share on its previous cpu */
+		if (cpu == prev_cpu)
+			util[cpu] -= min(util[cpu], task_util);
+		util[cpu] = max(util[cpu],
+				ACCESS_ONCE(cpu_rq(cpu)->util_queued));
+		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
+			allowed |= 1UL << cpu;
+	}
+
+	return energy_find_cpu(em, util, nr_cpu_ids, allowed, task_util,
+			       prev_cpu);
+}
+
+/*
+ * Whether a cpu of @sd is out of capacity, and so whether the load
+ * balancer should spread tasks there: up to then, it would only undo
+ * what energy_select_cpu() packed.
+ */
+static bool energy_sd_overutilized(struct sched_domain *sd)
+{
+	u64 now;
+	int cpu;
+
+	if (!energy_model())
+		return true;
+
+	now = sched_clock_cpu(smp_processor_id());
+	for_each_cpu(cpu, sched_domain_span(sd))
+		if (!energy_fits(energy_cpu_util(cpu, now)))
+			return true;
+	return false;
+}
+
+/*
+ * Fold the running time since the last sample into the average, with
+ * a weight of 1/4, once at least TASK_UTIL_MIN_PERIOD has gone by.
+ * @now may be from another cpu's clock than the last sample.
+ */
+static void update_task_util(struct sched_task_util *tu, u64 now, u64 exec)
+{
+	u64 period = now - tu->sample_start;
+	unsigned long sample;
+
+	if (!tu->sample_start || (s64)period < 0)
+		goto restart;
+	if (period < TASK_UTIL_MIN_PERIOD)
+		return;
+
+	sample = min_t(u64, div64_u64((exec - tu->sample_exec) <<
+				      SCHED_POWER_SHIFT, period),
+		       SCHED_POWER_SCALE);
+	tu->avg = (tu->avg * 3 + sample) >> 2;
+restart:
+	tu->sample_start = now;
+	tu->sample_exec = exec;
+}
+
+static inline void energy_task_enqueue(struct rq *rq, struct task_struct *p)
+{
+	p->se.util.queued = p->se.util.avg;
+	rq->util_queued += p->se.util.queued;
+}
+
+static inline void energy_task_dequeue(struct rq *rq, struct task_struct *p,
+				       int sleep)
+{
+	rq->util_queued -= min(rq->util_queued, p->se.util.queued);
+	if (sleep)
+		update_task_util(&p->se.util, rq->clock_task,
+				 p->se.sum_exec_runtime);
+}
+
+/*
+ * A new task starts at half a cpu, which does not fit with much else:
+ * it is spread until it has shown how light it is.
+ */
+static inline void init_task_util(struct sched_task_util *tu)
+{
+	tu->sample_start = 0;
+	tu->sample_exec = 0;
+	tu->avg = SCHED_POWER_SCALE / 2;
+	tu->queued = 0;
+}
+
+static inline void energy_task_fork(struct task_struct *p)
+{
+	init_task_util(&p->se.util);
+}
+
+#ifdef CONFIG_SCHED_DEBUG
+/*
+ * Replay of a task trace against the energy model, in steps of 1ms,
+ * with tasks placed by energy_find_cpu() and by a stand-in for the
+ * usual wakeup balancing, which takes an idle cpu if there is one:
+ *
+ *	cd /sys/kernel/debug/sched_energy
+ *	echo 2 > cpus
+ *	printf "0 0 3000\n0 1 2000\n16 0 3000\n" > trace
+ *	cat report
+ *
+ * Each line of the trace is "<wake_ms> <task> <run_us>", with run_us
+ * the time the task runs at full capacity; wake_ms must not decrease.
+ * A cpu runs its tasks in order at the OPP the 'sched' governor would
+ * pick from the same utilization the scheduler sees, and the report
+ * gives the energy the model says that took, and how long tasks waited
+ * past their wakeup for the work to be done.
+ */
+#define SIM_MAX_EVENTS		4096
+#define SIM_MAX_TASKS		32
+#define SIM_MAX_STEPS		(600 * MSEC_PER_SEC)
+
+struct energy_sim_event {
+	unsigned int wake_ms;
+	unsigned int task;
+	unsigned int run_us;
+};
+
+struct energy_sim_task {
+	struct sched_task_util util;
+	u64 exec_ns;
+	unsigned int left_us;		/* work at full capacity, if queued */
+	unsigned int wake_ms;
+	int cpu;
+};
+
+struct energy_sim_cpu {
+	int queue[SIM_MAX_TASKS];	/* tasks, in the order they run */
+	int nr_queued;
+	unsigned long util;		/* as rq->util_avg */
+	unsigned int util_ms;		/* as rq->util_last_update */
+	unsigned long util_queued;	/* as rq->util_queued */
+	unsigned int busy_ms;
+};
+
+struct energy_sim {
+	struct energy_sim_task tasks[SIM_MAX_TASKS];
+	struct energy_sim_cpu cpus[ENERGY_MAX_CPUS];
+	u64 energy_nj;
+	u64 latency_us;
+	unsigned int max_latency_us;
+	unsigned int jobs;
+	unsigned int msecs;
+	unsigned int residency_ms[];	/* by cap state */
+};
+
+/* Serialises trace writes and replays */
+static DEFINE_MUTEX(energy_sim_mutex);
+static struct energy_sim_event energy_sim_trace[SIM_MAX_EVENTS];
+static unsigned int energy_sim_nr_events;
+static u32 energy_sim_nr_cpus = 2;
+
+/*
+ * As energy_cpu_util(): an idle cpu has stopped its tick and last
+ * updated its utilization at util_ms.
+ */
+static unsigned long energy_sim_util(const struct energy_sim_cpu *sc,
+				     unsigned int ms)
+{
+	if (sc->nr_queued)
+		return sc->util;
+	return util_decay(sc->util, ms - sc->util_ms);
+}
+
+/* What select_idle_sibling() would mostly do: prev if idle, else any idle */
+static int energy_sim_spread(struct energy_sim *sim, int nr, int prev)
+{
+	int i, best = prev;
+
+	if (!sim->cpus[prev].nr_queued)
+		return prev;
+	for (i = 0; i < nr; i++) {
+		if (!sim->cpus[i].nr_queued)
+			return i;
+		/* All busy, so all up to date */
+		if (sim->cpus[i].util < sim->cpus[best].util)
+			best = i;
+	}
+	return best;
+}
+
+static void energy_sim_wake(struct energy_sim *sim,
+			    const struct sched_energy_model *em, int nr,
+			    bool energy, const struct energy_sim_event *ev)
+{
+	struct energy_sim_task *t = &sim->tasks[ev->task];
+	unsigned long util[ENERGY_MAX_CPUS];
+	struct energy_sim_cpu *sc;
+	int i, cpu = -1;
+
+	if (t->left_us) {
+		/* Still queued: more work for the same wakeup */
+		t->left_us += ev->run_us;
+		return;
+	}
+
+	if (energy) {
+		for (i = 0; i < nr; i++) {
+			util[i] = energy_sim_util(&sim->cpus[i], ev->wake_ms);
+			if (i == t->cpu)
+				util[i] -= min(util[i], t->util.avg);
+			util[i] = max(util[i], sim->cpus[i].util_queued);
+		}
+		cpu = energy_find_cpu(em, util, nr, (1UL << nr) - 1,
+				      t->util.avg, t->cpu);
+	}
+	if (cpu < 0)
+		cpu = energy_sim_spread(sim, nr, t->cpu);
+
+	t->cpu = cpu;
+	t->left_us = ev->run_us;
+	t->wake_ms = ev->wake_ms;
+	t->util.queued = t->util.avg;
+	sc = &sim->cpus[cpu];
+	/* The enqueue folds in the idle time, as update_rq_util() does */
+	if (!sc->nr_queued) {
+		sc->util = energy_sim_util(sc, ev->wake_ms);
+		sc->util_ms = ev->wake_ms;
+	}
+	sc->queue[sc->nr_queued++] = ev->task;
+	sc->util_queued += t->util.queued;
+}
+
+/* Runs the cpus for the millisecond from @ms */
+static void energy_sim_step(struct energy_sim *sim,
+			    const struct sched_energy_model *em, int nr,
+			    unsigned int ms)
+{
+	const struct sched_cap_state *cs = NULL;
+	unsigned long max_util = 0, util, busy_util, idle_power;
+	unsigned int used_us, run_us, work_us, latency_us;
+	struct energy_sim_task *t;
+	struct energy_sim_cpu *sc;
+	int i;
+
+	if (em->shared_clock) {
+		for (i = 0; i < nr; i++)
+			max_util = max(max_util,
+				       energy_sim_util(&sim->cpus[i], ms));
+		cs = energy_cap_state(em, max_util);
+		sim->residency_ms[cs - em->cap_states]++;
+	}
+
+	for (i = 0; i < nr; i++) {
+		sc = &sim->cpus[i];
+		util = energy_sim_util(sc, ms);
+		if (!em->shared_clock)
+			cs = energy_cap_state(em, util);
+		/* As energy_power() has it */
+		idle_power = util ? em->idle_states[0].power :
+			em->idle_states[em->nr_idle_states - 1].power;
+
+		used_us = 0;
+		while (sc->nr_queued && used_us < USEC_PER_MSEC) {
+			t = &sim->tasks[sc->queue[0]];
+			/* Time the work left takes at this OPP */
+			run_us = DIV_ROUND_UP(t->left_us * SCHED_POWER_SCALE,
+					      cs->cap);
+			if (run_us > USEC_PER_MSEC - used_us) {
+				run_us = USEC_PER_MSEC - used_us;
+				work_us = run_us * cs->cap / SCHED_POWER_SCALE;
+				t->left_us -= min(t->left_us, work_us);
+				if (t->left_us) {
+					used_us += run_us;
+					t->exec_ns += run_us * NSEC_PER_USEC;
+					break;
+				}
+			}
+			used_us += run_us;
+			t->exec_ns += run_us * NSEC_PER_USEC;
+			t->left_us = 0;
+
+			latency_us = ms * USEC_PER_MSEC + used_us -
+				     t->wake_ms * USEC_PER_MSEC;
+			sim->latency_us += latency_us;
+			sim->max_latency_us = max(sim->max_latency_us,
+						  latency_us);
+			sim->jobs++;
+			sc->util_queued -= min(sc->util_queued, t->util.queued);
+			update_task_util(&t->util, (u64)ms * NSEC_PER_MSEC +
+					 used_us * NSEC_PER_USEC + 1, t->exec_ns);
+
+			sc->nr_queued--;
+			memmove(sc->queue, sc->queue + 1,
+				sc->nr_queued * sizeof(sc->queue[0]));
+		}
+
+		sim->energy_nj += cs->power * used_us +
+				  idle_power * (USEC_PER_MSEC - used_us);
+		if (used_us)
+			sc->busy_ms++;
+
+		/* A cpu idle for the whole step has no tick to update it */
+		if (!used_us && !sc->nr_queued)
+			continue;
+		busy_util = used_us * SCHED_POWER_SCALE / USEC_PER_MSEC;
+		sc->util = util_decay(util, 1) +
+			   busy_util - util_decay(busy_util, 1);
+		sc->util_ms = ms + 1;
+	}
+}
+
+static struct energy_sim *energy_sim_run(const struct sched_energy_model *em,
+					 int nr, bool energy)
+{
+	const struct energy_sim_event *ev = energy_sim_trace;
+	const struct energy_sim_event *end = ev + energy_sim_nr_events;
+	struct energy_sim *sim;
+	unsigned int ms;
+	int i;
+
+	sim = kzalloc(sizeof(*sim) + em->nr_cap_states *
+		      sizeof(sim->residency_ms[0]), GFP_KERNEL);
+	if (!sim)
+		return NULL;
+	for (i = 0; i < SIM_MAX_TASKS; i++)
+		init_task_util(&sim->tasks[i].util);
+
+	for (ms = 0; ms < SIM_MAX_STEPS; ms++) {
+		for (; ev < end && ev->wake_ms <= ms; ev++)
+			energy_sim_wake(sim, em, nr, energy, ev);
+		energy_sim_step(sim, em, nr, ms);
+
+		if (ev == end) {
+			for (i = 0; i < nr; i++)
+				if (sim->cpus[i].nr_queued)
+					break;
+			if (i == nr)
+				break;
+		}
+		if (!(ms % MSEC_PER_SEC))
+			cond_resched();
+	}
+	sim->msecs = min_t(unsigned int, ms + 1, SIM_MAX_STEPS);
+	return sim;
+}
+
+static void energy_sim_report(struct seq_file *m,
+			      const struct sched_energy_model *em, int nr,
+			      const char *name, struct energy_sim *sim)
+{
+	int i;
+
+	seq_printf(m, "%s: %llu mJ in %u ms, %u wakeups, latency mean %u us, "
+		   "max %u us\n", name, div_u64(sim->energy_nj, NSEC_PER_MSEC),
+		   sim->msecs, sim->jobs,
+		   sim->jobs ? (unsigned int)div_u64(sim->latency_us,
+						     sim->jobs) : 0,
+		   sim->max_latency_us);
+	seq_printf(m, "  busy ms:");
+	for (i = 0; i < nr; i++)
+		seq_printf(m, " %u", sim->cpus[i].busy_ms);
+	seq_printf(m, "\n");
+	if (em->shared_clock) {
+		seq_printf(m, "  residency ms by capacity:");
+		for (i = 0; i < em->nr_cap_states; i++)
+			seq_printf(m, " %lu:%u", em->cap_states[i].cap,
+				   sim->residency_ms[i]);
+		seq_printf(m, "\n");
+	}
+}
+
+static int energy_sim_report_show(struct seq_file *m, void *v)
+{
+	const struct sched_energy_model *em = ACCESS_ONCE(sched_energy);
+	struct energy_sim *spread = NULL, *energy = NULL;
+	int nr, ret = 0;
+
+	if (!em) {
+		seq_printf(m, "no energy model\n");
+		return 0;
+	}
+	smp_rmb();
+
+	mutex_lock(&energy_sim_mutex);
+	nr = clamp_t(u32, energy_sim_nr_cpus, 1, ENERGY_MAX_CPUS);
+	if (!energy_sim_nr_events) {
+		seq_printf(m, "no trace\n");
+		goto unlock;
+	}
+
+	spread = energy_sim_run(em, nr, false);
+	energy = energy_sim_run(em, nr, true);
+	if (!spread || !energy) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	seq_printf(m, "%d cpus, %u wakeups in the trace\n", nr,
+		   energy_sim_nr_events);
+	energy_sim_report(m, em, nr, "spread", spread);
+	energy_sim_report(m, em, nr, "energy", energy);
+unlock:
+	mutex_unlock(&energy_sim_mutex);
+	kfree(spread);
+	kfree(energy);
+	return ret;
+}
+
+static int energy_sim_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_sim_report_show, NULL);
+}
+
+static const struct file_operations energy_sim_report_fops = {
+	.open		= energy_sim_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int energy_sim_trace_open(struct inode *inode, struct file *file)
+{
+	if (file->f_flags & O_TRUNC) {
+		mutex_lock(&energy_sim_mutex);
+		energy_sim_nr_events = 0;
+		mutex_unlock(&energy_sim_mutex);
+	}
+	return 0;
+}
+
+/* Called with energy_sim_mutex held */
+static int energy_sim_trace_line(char *line, void *data)
+{
+	struct energy_sim_event *ev;
+
+	if (energy_sim_nr_events == SIM_MAX_EVENTS)
+		return -ENOSPC;
+	ev = &energy_sim_trace[energy_sim_nr_events];
+	if (sscanf(line, "%u %u %u", &ev->wake_ms, &ev->task,
+		   &ev->run_us) != 3 || ev->task >= SIM_MAX_TASKS ||
+	    ev->wake_ms >= SIM_MAX_STEPS ||
+	    (energy_sim_nr_events && ev->wake_ms < ev[-1].wake_ms))
+		return -EINVAL;
+	energy_sim_nr_events++;
+	return 0;
+}
+
+static ssize_t energy_sim_trace_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&energy_sim_mutex);
+	ret = simple_write_lines(ubuf, count, energy_sim_trace_line, NULL);
+	mutex_unlock(&energy_sim_mutex);
+	return ret;
+}
+
+static const struct file_operations energy_sim_trace_fops = {
+	.open		= energy_sim_trace_open,
+	.write		= energy_sim_trace_write,
+};
+
+static __init int energy_sim_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("sched_energy", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_u32("cpus", 0644, dir, &energy_sim_nr_cpus);
+	debugfs_create_file("trace", 0200, dir, NULL, &energy_sim_trace_fops);
+	debugfs_create_file("report", 0400, dir, NULL,
+			    &energy_sim_report_fops);
+	return 0;
+}
+late_initcall(energy_sim_init);
+
+#endif /* CONFIG_SCHED_DEBUG */
+
+#else /* CONFIG_SCHED_ENERGY */
+
+#ifdef CONFIG_SMP
+static inline int energy_select_cpu(struct task_struct *p, int prev_cpu)
+{
+	return -1;
+}
+
+static inline bool energy_sd_overutilized(struct sched_domain *sd)
+{
+	return true;
+}
+#endif
+
+static inline void energy_task_enqueue(struct rq *rq, struct task_struct *p)
+{
+}
+
+static inline void energy_task_dequeue(struct rq *rq, struct task_struct *p,
+				       int sleep)
+{
+}
+
+static inline void energy_task_fork(struct task_struct *p)
+{
+}
+
+#endif /* CONFIG_SCHED_ENERGY */
@@ -0,0 +1,159 @@
+/*
+ * LZ4 compressor
+ *
+ * Greedy single-pass LZ77 over a 4096-entry hash table of the last
+ * position seen for each 4-byte sequence. Runs of data with no match
+ * are skipped with an increasing stride so incompressible input costs
+ * little.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_read32(const u8 *p)
+{
+	return get_unaligned((const u32 *)p);
+}
+
+static inline u32 lz4_hash(u32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Bytes needed to encode a length that does not fit in its nibble */
+static inline size_t lz4_length_bytes(size_t len, unsigned int mask)
+{
+	if (len < mask)
+		return 0;
+	return 1 + (len - mask) / 255;
+}
+
+static u8 *lz4_put_length(u8 *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (u8)len;
+	return op;
+}
+
+static u8 *lz4_put_literals(u8 *op, const u8 *anchor, size_t lit_len,
+			    u8 **token)
+{
+	*token = op++;
+	if (lit_len >= RUN_MASK) {
+		**token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, lit_len - RUN_MASK);
+	} else
+		**token = lit_len << ML_BITS;
+
+	memcpy(op, anchor, lit_len);
+	return op + lit_len;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	const u8 **hash_table = wrkmem;
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	const u8 *const iend = src + src_len;
+	const u8 *const mflimit = iend - MFLIMIT;
+	const u8 *const matchlimit = iend - LASTLITERALS;
+	u8 *op = dst;
+	u8 *const oend = dst + *dst_len;
+	u8 *token;
+	size_t lit_len;
+
+	if (src_len < MFLIMIT + 1)
+		goto last_literals;
+
+	memset(hash_table, 0, LZ4_MEM_COMPRESS);
+	hash_table[lz4_hash(lz4_read32(ip))] = ip;
+	ip++;
+
+	while (ip < mflimit) {
+		unsigned int attempts = (1U << LZ4_SKIP_TRIGGER) + 3;
+		const u8 *ref;
+		const u8 *match_end;
+		size_t match_len;
+		u32 h;
+
+		/* Find a 4-byte match within MAX_DISTANCE */
+		for (;;) {
+			u32 sequence = lz4_read32(ip);
+
+			h = lz4_hash(sequence);
+			ref = hash_table[h];
+			hash_table[h] = ip;
+			if (ref && ip - ref <= MAX_DISTANCE &&
+			    lz4_read32(ref) == sequence)
+				break;
+
+			ip += attempts++ >> LZ4_SKIP_TRIGGER;
+			if (ip >= mflimit)
+				goto last_literals;
+		}
+
+		/* Extend the match backwards over pending literals */
+		while (ip > anchor && ref > (const u8 *)src &&
+		       ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* and forwards, stopping short of the trailing literals */
+		match_end = ip + MINMATCH;
+		ref += MINMATCH;
+		while (match_end + sizeof(u32) <= matchlimit &&
+		       lz4_read32(match_end) == lz4_read32(ref)) {
+			match_end += sizeof(u32);
+			ref += sizeof(u32);
+		}
+		while (match_end < matchlimit && *match_end == *ref) {
+			match_end++;
+			ref++;
+		}
+
+		lit_len = ip - anchor;
+		match_len = match_end - ip - MINMATCH;
+		if (op + 1 + lz4_length_bytes(lit_len, RUN_MASK) + lit_len +
+		    2 + lz4_length_bytes(match_len, ML_MASK) > oend)
+			return -1;
+
+		op = lz4_put_literals(op, anchor, lit_len, &token);
+		put_unaligned_le16((u16)(match_end - ref), op);
+		op += 2;
+		if (match_len >= ML_MASK) {
+			*token |= ML_MASK;
+			op = lz4_put_length(op, match_len - ML_MASK);
+		} else
+			*token |= match_len;
+
+		ip = anchor = match_end;
+		if (ip >= mflimit)
+			break;
+		/* Remember a position inside the match for later ones */
+		hash_table[lz4_hash(lz4_read32(ip - 2))] = ip - 2;
+	}
+
+last_literals:
+	lit_len = iend - anchor;
+	if (op + 1 + lz4_length_bytes(lit_len, RUN_MASK) + lit_len > oend)
+		return -1;
+	op = lz4_put_literals(op, anchor, lit_len, &token);
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Compressor");
@@ -0,0 +1,106 @@
+/*
+ * LZ4 decompressor
+ *
+ * Every length read from the input is checked against both the
+ * remaining input and the remaining output, so corrupted or hostile
+ * data can never make it read or write out of bounds.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include <asm/unaligned.h>
+#include "lz4defs.h"
+
+/*
+ * Add the extension bytes of a length whose nibble saturated. Fails
+ * if the input runs out or the length exceeds 'limit'.
+ */
+static inline int lz4_get_length(const u8 **ip, const u8 *iend,
+				 size_t *len, size_t limit)
+{
+	unsigned int s;
+
+	do {
+		if (unlikely(*ip >= iend))
+			return -1;
+		s = *(*ip)++;
+		*len += s;
+		if (unlikely(*len > limit))
+			return -1;
+	} while (s == 255);
+
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const u8 *ip = src;
+	const u8 *const iend = src + src_len;
+	u8 *op = dest;
+	u8 *const oend = dest + *dest_len;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		size_t offset;
+		size_t len;
+		const u8 *ref;
+
+		/* literals */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK &&
+		    lz4_get_length(&ip, iend, &len, oend - op))
+			goto fail;
+		if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+			goto fail;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			goto fail;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dest))
+			goto fail;
+		ref = op - offset;
+
+		len = token & ML_MASK;
+		if (len == ML_MASK &&
+		    lz4_get_length(&ip, iend, &len, oend - op))
+			goto fail;
+		len += MINMATCH;
+		if (len > (size_t)(oend - op))
+			goto fail;
+
+		if (offset >= len) {
+			memcpy(op, ref, len);
+			op += len;
+		} else {
+			/* overlapping copy replicates the last offset bytes */
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+fail:
+	return -1;
+}
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
@@ -0,0 +1,35 @@
+/*
+ * LZ4 block format definitions shared by the compressor and the
+ * decompressor.
+ *
+ * A block is a series of sequences. Each sequence is a token byte
+ * whose high nibble is the literal run length and low nibble the
+ * match length minus MINMATCH (a nibble of 15 means more length bytes
+ * follow, each adding up to 255), then the literals, then a 16-bit
+ * little-endian match offset. The final sequence carries literals
+ * only.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define MINMATCH	4
+
+/* The last match must start at least MFLIMIT bytes before the end */
+#define MFLIMIT		12
+/* and the last LASTLITERALS bytes are always literals */
+#define LASTLITERALS	5
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	65535
+
+#define LZ4_HASH_LOG	12
+#define LZ4_HASH_SIZE	(1U << LZ4_HASH_LOG)
+
+/* Step up the search stride after this many consecutive misses */
+#define LZ4_SKIP_TRIGGER	6
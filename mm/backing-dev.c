@@ -204,12 +204,42 @@ static ssize_t max_ratio_store(struct device *dev,
 }
 BDI_SHOW(max_ratio, bdi->max_ratio)
 
+static ssize_t read_ahead_adaptive_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	char *end;
+	unsigned long val;
+	ssize_t ret = -EINVAL;
+
+	val = simple_strtoul(buf, &end, 10);
+	if (*buf && (end[0] == '\0' || (end[0] == '\n' && end[1] == '\0'))) {
+		bdi->ra_adaptive = !!val;
+		ret = count;
+	}
+	return ret;
+}
+BDI_SHOW(read_ahead_adaptive, bdi->ra_adaptive)
+
+static ssize_t read_ahead_stats_show(struct device *dev,
+				     struct device_attribute *attr, char *page)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+
+	return snprintf(page, PAGE_SIZE-1, "%llu %llu %llu\n",
+			(unsigned long long)bdi_stat_sum(bdi, BDI_RA_PAGES),
+			(unsigned long long)bdi_stat_sum(bdi, BDI_RA_HIT),
+			(unsigned long long)bdi_stat_sum(bdi, BDI_RA_MISS));
+}
+
 #define __ATTR_RW(attr) __ATTR(attr, 0644, attr##_show, attr##_store)
 
 static struct device_attribute bdi_dev_attrs[] = {
 	__ATTR_RW(read_ahead_kb),
 	__ATTR_RW(min_ratio),
 	__ATTR_RW(max_ratio),
+	__ATTR_RW(read_ahead_adaptive),
+	__ATTR(read_ahead_stats, 0444, read_ahead_stats_show, NULL),
 	__ATTR_NULL,
 };
 
@@ -31,11 +31,15 @@
 #include <linux/mm.h>          /* PAGE_ALIGN() */
 #include <linux/module.h>      /* EXPORT_SYMBOL_GPL() */
 #include <linux/mutex.h>       /* mutex */
+#include <linux/pfn.h>         /* PFN_DOWN() */
 #include <linux/slab.h>        /* kmalloc() */
 #include <linux/string.h>      /* str*() */
 
 #include <linux/cma.h>
 #include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/uaccess.h>
 
 /*
  * Protects cma_regions, cma_allocators, cma_map, cma_map_length,
@@ -248,6 +252,15 @@ int __init __must_check cma_early_region_register(struct cma_region *reg)
 	start     = ALIGN(reg->start, alignment);
 	size      = PAGE_ALIGN(reg->size);
 
+#ifdef CONFIG_CMA_MIGRATE
+	/* The page allocator gets whole MAX_ORDER blocks of the region */
+	if (reg->migratable) {
+		alignment = max(alignment, CMA_MIGRATE_ALIGN);
+		start     = ALIGN(reg->start, alignment);
+		size      = ALIGN(reg->size, CMA_MIGRATE_ALIGN);
+	}
+#endif
+
 	if (start + size < start)
 		return -EINVAL;
 
@@ -294,6 +307,7 @@ int __must_check cma_region_register(struct cma_region *reg)
 	reg->used = 0;
 	reg->private_data = NULL;
 	reg->registered = 0;
+	reg->lent = 0;
 	reg->free_space = reg->size;
 
 	/* Copy name and alloc_name */
@@ -570,6 +584,52 @@ void __init cma_early_regions_reserve(int (*reserve)(struct cma_region *reg))
 }
 
 
+#ifdef CONFIG_CMA_MIGRATE
+
+/*
+ * Give the pages of a reserved region to the page allocator.  They will
+ * be used for movable allocations only, and migrated elsewhere when
+ * cma_alloc() needs them.
+ */
+static void __init __cma_region_lend(struct cma_region *reg)
+{
+	unsigned long pfn = PFN_DOWN(reg->start);
+	unsigned long end = pfn + (reg->size >> PAGE_SHIFT);
+	unsigned long align = max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				    pageblock_nr_pages);
+	struct zone *zone;
+	unsigned long i;
+
+	if ((pfn | end) & (align - 1)) {
+		pr_warn("init: %s: not aligned to %lu pages, not lending it\n",
+			reg->name ?: "(private)", align);
+		return;
+	}
+
+	zone = page_zone(pfn_to_page(pfn));
+	for (i = pfn; i < end; ++i) {
+		if (!pfn_valid(i) || page_zone(pfn_to_page(i)) != zone) {
+			pr_warn("init: %s: spans several zones, not lending it\n",
+				reg->name ?: "(private)");
+			return;
+		}
+	}
+
+	for (i = pfn; i < end; i += pageblock_nr_pages)
+		init_cma_reserved_pageblock(pfn_to_page(i));
+	reg->lent = 1;
+
+	pr_debug("init: %s: lent %p@%p to the page allocator\n",
+		 reg->name ?: "(private)",
+		 (void *)reg->size, (void *)reg->start);
+}
+
+#else
+
+static inline void __cma_region_lend(struct cma_region *reg) { }
+
+#endif
+
 static int __init cma_init(void)
 {
 	struct cma_region *reg, *n;
@@ -595,8 +655,10 @@ static int __init cma_init(void)
 		 * cma_early_region_register() it's caller's
 		 * responsibility to do something about it.
 		 */
-		if (reg->reserved && cma_region_register(reg) < 0)
-			/* ignore error */;
+		if (!reg->reserved || cma_region_register(reg) < 0)
+			continue;	/* ignore error */
+		if (reg->migratable)
+			__cma_region_lend(reg);
 	}
 
 	INIT_LIST_HEAD(&cma_early_regions);
@@ -996,6 +1058,12 @@ static void __cma_chunk_free(struct cma_chunk *chunk)
 {
 	rb_erase(&chunk->by_start, &cma_chunks_by_start);
 
+#ifdef CONFIG_CMA_MIGRATE
+	if (chunk->reg->lent)
+		free_contig_range(PFN_DOWN(chunk->start),
+				  chunk->size >> PAGE_SHIFT);
+#endif
+
 	chunk->reg->alloc->free(chunk);
 	--chunk->reg->users;
 	chunk->reg->free_space += chunk->size;
@@ -1010,6 +1078,53 @@ __cma_where_from(const struct device *dev, const char *type);
 
 /* Allocate. */
 
+#ifdef CONFIG_CMA_MIGRATE
+
+/* How many places to try before giving up on a busy lent region */
+#define CMA_LENT_RETRIES	4
+
+/*
+ * In a lent region the allocator's chunk may still hold pages that
+ * cannot be migrated right now (pinned for I/O, say).  Such chunks are
+ * kept allocated while trying again so that another place is picked.
+ */
+static struct cma_chunk *__must_check
+__cma_chunk_alloc(struct cma_region *reg, size_t size, dma_addr_t alignment)
+{
+	struct cma_chunk *chunk, *busy[CMA_LENT_RETRIES];
+	int n = 0;
+
+	for (;;) {
+		chunk = reg->alloc->alloc(reg, size, alignment);
+		if (!chunk || !reg->lent ||
+		    !alloc_contig_range(PFN_DOWN(chunk->start),
+					PFN_DOWN(chunk->start + chunk->size)))
+			break;
+
+		if (n == CMA_LENT_RETRIES) {
+			reg->alloc->free(chunk);
+			chunk = NULL;
+			break;
+		}
+		busy[n++] = chunk;
+	}
+
+	while (n--)
+		reg->alloc->free(busy[n]);
+
+	return chunk;
+}
+
+#else
+
+static inline struct cma_chunk *__must_check
+__cma_chunk_alloc(struct cma_region *reg, size_t size, dma_addr_t alignment)
+{
+	return reg->alloc->alloc(reg, size, alignment);
+}
+
+#endif
+
 static dma_addr_t __must_check
 __cma_alloc_from_region(struct cma_region *reg,
 			size_t size, dma_addr_t alignment)
@@ -1030,7 +1145,7 @@ __cma_alloc_from_region(struct cma_region *reg,
 			return -ENOMEM;
 	}
 
-	chunk = reg->alloc->alloc(reg, size, alignment);
+	chunk = __cma_chunk_alloc(reg, size, alignment);
 	if (!chunk)
 		return -ENOMEM;
 
@@ -1232,6 +1347,122 @@ int cma_free(dma_addr_t addr)
 EXPORT_SYMBOL_GPL(cma_free);
 
 
+/************************* DebugFS *************************/
+
+#if defined CONFIG_CMA_DEBUGFS
+
+struct cma_alloc_test {
+	s64 alloc_ns;
+	s64 free_ns;
+};
+
+static int cma_debugfs_alloc_test_open(struct inode *inode, struct file *file)
+{
+	file->private_data = kzalloc(sizeof(struct cma_alloc_test),
+				     GFP_KERNEL);
+	return file->private_data ? 0 : -ENOMEM;
+}
+
+static int cma_debugfs_alloc_test_release(struct inode *inode,
+					  struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+/*
+ * Results are kept per open file, so that concurrent users each read
+ * back the timing of their own last write.
+ */
+static ssize_t cma_debugfs_alloc_test_read(struct file *file,
+					   char __user *buf,
+					   size_t count, loff_t *ppos)
+{
+	struct cma_alloc_test *test = file->private_data;
+	char page[48];
+	int len;
+
+	len = snprintf(page, sizeof page, "%lld %lld\n",
+		       (long long)test->alloc_ns, (long long)test->free_ns);
+	return simple_read_from_buffer(buf, count, ppos, page, len);
+}
+
+static ssize_t cma_debugfs_alloc_test_write(struct file *file,
+					    const char __user *buf,
+					    size_t count, loff_t *ppos)
+{
+	struct cma_alloc_test *test = file->private_data;
+	struct cma_region *reg;
+	const char *name;
+	char page[64], *s;
+	dma_addr_t addr;
+	size_t size;
+	ktime_t start;
+
+	if (count >= sizeof page)
+		return -EINVAL;
+	if (copy_from_user(page, buf, count))
+		return -EFAULT;
+	page[count] = '\0';
+
+	/* "<region> <size>" */
+	s = strchr(page, ' ');
+	if (!s)
+		return -EINVAL;
+	*s++ = '\0';
+	size = memparse(s, &s);
+	if (!size)
+		return -EINVAL;
+
+	name = page;
+	mutex_lock(&cma_mutex);
+	reg = __cma_region_find(&name);
+	mutex_unlock(&cma_mutex);
+	if (!reg)
+		return -ENOENT;
+
+	start = ktime_get();
+	addr = cma_alloc_from_region(reg, size, 0);
+	test->alloc_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (IS_ERR_VALUE(addr))
+		return addr;
+
+	start = ktime_get();
+	cma_free(addr);
+	test->free_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return count;
+}
+
+static const struct file_operations cma_debugfs_alloc_test_fops = {
+	.open		= cma_debugfs_alloc_test_open,
+	.read		= cma_debugfs_alloc_test_read,
+	.write		= cma_debugfs_alloc_test_write,
+	.release	= cma_debugfs_alloc_test_release,
+	.llseek		= default_llseek,
+};
+
+static int __init cma_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("cma", NULL);
+	if (IS_ERR_OR_NULL(root))
+		return -ENOMEM;
+
+	if (!debugfs_create_file("alloc_test", 0600, root, NULL,
+				 &cma_debugfs_alloc_test_fops)) {
+		debugfs_remove(root);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(cma_debugfs_init);
+
+#endif
+
+
 /************************* Miscellaneous *************************/
 
 static int __cma_region_attach_alloc(struct cma_region *reg)
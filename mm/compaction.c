@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,6 +45,7 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool kcompactd;			/* Background: restore a reserve */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -123,8 +127,8 @@ static bool suitable_migration_target(struct page *page)
 	if (PageBuddy(page) && page_order(page) >= pageblock_order)
 		return true;
 
-	/* If the block is MIGRATE_MOVABLE, allow migration */
-	if (migratetype == MIGRATE_MOVABLE)
+	/* If the block is MIGRATE_MOVABLE or MIGRATE_CMA, allow migration */
+	if (migratetype == MIGRATE_MOVABLE || is_migrate_cma(migratetype))
 		return true;
 
 	/* Otherwise skip the block */
@@ -352,13 +356,14 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 			continue;
 
 		/*
-		 * For async migration, also only scan in MOVABLE blocks. Async
-		 * migration is optimistic to see if the minimum amount of work
-		 * satisfies the allocation
+		 * For async migration, also only scan in MOVABLE and CMA
+		 * blocks. Async migration is optimistic to see if the minimum
+		 * amount of work satisfies the allocation
 		 */
 		pageblock_nr = low_pfn >> pageblock_order;
 		if (!cc->sync && last_pageblock_nr != pageblock_nr &&
-				get_pageblock_migratetype(page) != MIGRATE_MOVABLE) {
+				get_pageblock_migratetype(page) != MIGRATE_MOVABLE &&
+				!is_migrate_cma(get_pageblock_migratetype(page))) {
 			low_pfn += pageblock_nr_pages;
 			low_pfn = ALIGN(low_pfn, pageblock_nr_pages) - 1;
 			last_pageblock_nr = pageblock_nr;
@@ -451,6 +456,26 @@ static void update_nr_listpages(struct compact_control *cc)
 	cc->nr_freepages = nr_freepages;
 }
 
+int sysctl_compaction_proactive_threshold = 500;
+
+/*
+ * kcompactd keeps a quarter of the low watermark free as blocks of each
+ * order it looks after, so that bursts of such allocations from drivers
+ * are served without compacting directly.
+ */
+static unsigned long kcompactd_reserve(struct zone *zone, int order)
+{
+	return max(low_wmark_pages(zone) >> (order + 2), 1UL);
+}
+
+/* Is the zone short of @order blocks because its free memory is scattered? */
+static bool kcompactd_zone_needs(struct zone *zone, int order)
+{
+	return fragmentation_index_reserve(zone, order,
+			kcompactd_reserve(zone, order)) >
+		sysctl_compaction_proactive_threshold;
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -471,6 +496,14 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* kcompactd: done as soon as the zone has its reserve back */
+	if (cc->kcompactd) {
+		if (kthread_should_stop() ||
+		    !kcompactd_zone_needs(zone, cc->order))
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -542,11 +575,28 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_CONTINUE;
 }
 
+/* compaction_suitable() for kcompactd, which compacts ahead of failures */
+static unsigned long kcompactd_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark = low_wmark_pages(zone) + (2UL << order);
+
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return COMPACT_SKIPPED;
+
+	if (!kcompactd_zone_needs(zone, order))
+		return COMPACT_PARTIAL;
+
+	return COMPACT_CONTINUE;
+}
+
 static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 
-	ret = compaction_suitable(zone, cc->order);
+	if (cc->kcompactd)
+		ret = kcompactd_suitable(zone, cc->order);
+	else
+		ret = compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -648,6 +698,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 	int rc = COMPACT_SKIPPED;
+	ktime_t start;
 
 	/*
 	 * Check whether it is worth even starting compaction. The order check is
@@ -658,6 +709,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		return rc;
 
 	count_vm_event(COMPACTSTALL);
+	start = ktime_get();
 
 	/* Compact each zone in the list */
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
@@ -672,6 +724,8 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			break;
 	}
 
+	count_vm_events(COMPACTSTALLTIME, ktime_us_delta(ktime_get(), start));
+
 	return rc;
 }
 
@@ -746,6 +800,192 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/* Free blocks of @order or larger, counted in blocks of @order */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long blocks = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+
+	return blocks;
+}
+
+/*
+ * Compact each zone of the node that is short of blocks of the orders
+ * kcompactd looks after, stopping as soon as the reserve is back.
+ * Returns false if some zone is still short after a full pass.
+ */
+static bool kcompactd_do_work(pg_data_t *pgdat)
+{
+	ktime_t start = ktime_get();
+	bool done = true;
+	int zoneid, order;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		for (order = KCOMPACTD_MIN_ORDER;
+		     order <= KCOMPACTD_MAX_ORDER; order++) {
+			struct compact_control cc = {
+				.nr_freepages = 0,
+				.nr_migratepages = 0,
+				.order = order,
+				.migratetype = MIGRATE_MOVABLE,
+				.zone = zone,
+				.sync = false,
+				.kcompactd = true,
+			};
+			unsigned long before, after;
+
+			if (kthread_should_stop())
+				return true;
+
+			if (!kcompactd_zone_needs(zone, order))
+				continue;
+
+			before = zone_free_blocks(zone, order);
+			INIT_LIST_HEAD(&cc.freepages);
+			INIT_LIST_HEAD(&cc.migratepages);
+
+			/* Too little free memory: that is kswapd's job */
+			if (compact_zone(zone, &cc) == COMPACT_SKIPPED)
+				break;
+
+			/* Migration freed to the PCP lists: let them merge */
+			preempt_disable();
+			drain_local_pages(NULL);
+			preempt_enable();
+
+			after = zone_free_blocks(zone, order);
+			if (after > before)
+				count_vm_events(KCOMPACTD_BLOCKS, after - before);
+
+			if (kcompactd_zone_needs(zone, order))
+				done = false;
+		}
+	}
+
+	count_vm_events(KCOMPACTD_TIME, ktime_us_delta(ktime_get(), start));
+
+	return done;
+}
+
+/* Longest kcompactd waits after a pass that did not help: 64 seconds */
+#define KCOMPACTD_MAX_BACKOFF	6
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int backoff = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     pgdat->kcompactd_max_order ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		pgdat->kcompactd_max_order = 0;
+
+		if (kcompactd_do_work(pgdat)) {
+			backoff = 0;
+			continue;
+		}
+
+		/*
+		 * Whatever scatters the free memory, unmovable pages most
+		 * likely, is beyond compaction for now: every allocation
+		 * would wake us for the same fruitless scan, so sleep
+		 * through them for longer each time.
+		 */
+		if (backoff < KCOMPACTD_MAX_BACKOFF)
+			backoff++;
+		schedule_timeout_interruptible(HZ << backoff);
+		try_to_freeze();
+	}
+
+	return 0;
+}
+
+/*
+ * Called after a high-order allocation: wake the node's kcompactd if
+ * the zone is running short of blocks of that order. Free block counts
+ * barely move within a tick, so each zone is looked at once a jiffy;
+ * the unlocked update may let a racing allocation check again.
+ */
+void __wakeup_kcompactd(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (zone->kcompactd_checked == jiffies)
+		return;
+	zone->kcompactd_checked = jiffies;
+
+	if (!kcompactd_zone_needs(zone, order))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
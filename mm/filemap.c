@@ -1271,6 +1271,7 @@ no_cached_page:
 			desc->error = error;
 			goto out;
 		}
+		prefetch_trace_record(filp, index, 1);
 		goto readpage;
 	}
 
@@ -1524,8 +1525,10 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 			return -ENOMEM;
 
 		ret = add_to_page_cache_lru(page, mapping, offset, GFP_KERNEL);
-		if (ret == 0)
+		if (ret == 0) {
+			prefetch_trace_record(file, offset, 1);
 			ret = mapping->a_ops->readpage(file, page);
+		}
 		else if (ret == -EEXIST)
 			ret = 0; /* losing race to add is OK */
 
@@ -1576,7 +1579,8 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = max_sane_readahead(ra_adapt_max(mapping, ra, offset,
+						   ra->ra_pages));
 	ra->start = max_t(long, 0, offset - ra_pages / 2);
 	ra->size = ra_pages;
 	ra->async_size = ra_pages / 4;
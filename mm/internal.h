@@ -309,3 +309,22 @@ extern u64 hwpoison_filter_flags_mask;
 extern u64 hwpoison_filter_flags_value;
 extern u64 hwpoison_filter_memcg;
 extern u32 hwpoison_filter_enable;
+
+#ifdef CONFIG_PREFETCH_TRACE
+extern bool prefetch_trace_recording;
+extern void __prefetch_trace_record(struct file *filp, pgoff_t index,
+				    unsigned long nr);
+
+/* Note pages about to be read into the page cache of @filp */
+static inline void prefetch_trace_record(struct file *filp, pgoff_t index,
+					 unsigned long nr)
+{
+	if (unlikely(prefetch_trace_recording) && filp)
+		__prefetch_trace_record(filp, index, nr);
+}
+#else
+static inline void prefetch_trace_record(struct file *filp, pgoff_t index,
+					 unsigned long nr)
+{
+}
+#endif
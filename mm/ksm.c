@@ -36,6 +36,9 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -110,6 +113,32 @@ struct ksm_scan {
 	unsigned long seqnr;
 };
 
+/**
+ * struct ksm_scan_item - a page picked up by the scanner, awaiting merging
+ * @page: the page, with a reference held
+ * @rmap_item: the reverse mapping for the virtual address it was found at
+ * @checksum: checksum of the page contents, filled in by the scan threads
+ */
+struct ksm_scan_item {
+	struct page *page;
+	struct rmap_item *rmap_item;
+	u32 checksum;
+};
+
+/**
+ * struct ksm_scan_worker - one scan thread's share of a batch
+ * @work: queued on ksm_scan_wq
+ * @items: first item of the share
+ * @nr: number of items in the share
+ * @cpu_ns: cpu time spent on the share
+ */
+struct ksm_scan_worker {
+	struct work_struct work;
+	struct ksm_scan_item *items;
+	int nr;
+	u64 cpu_ns;
+};
+
 /**
  * struct stable_node - node of the stable rbtree
  * @node: rb node of this ksm page in the stable tree
@@ -189,6 +218,24 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * ksmd picks up to KSM_SCAN_BATCH pages from one mm at a time, has them
+ * checksummed by ksm_scan_threads threads (itself included), then merges
+ * them one by one: the trees are only ever touched by ksmd itself.
+ */
+#define KSM_SCAN_BATCH		256
+#define KSM_MAX_SCAN_THREADS	8
+static unsigned int ksm_scan_threads = 1;
+static struct ksm_scan_item ksm_scan_batch[KSM_SCAN_BATCH];
+static struct ksm_scan_worker ksm_scan_workers[KSM_MAX_SCAN_THREADS];
+static struct workqueue_struct *ksm_scan_wq;
+
+/* Scanner throughput, protected by ksm_thread_mutex */
+static u64 ksm_pages_scanned;
+static u64 ksm_pages_merged;
+static u64 ksm_scan_wall_ns;
+static u64 ksm_scan_cpu_ns;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -678,14 +725,28 @@ static u32 calc_checksum(struct page *page)
 	return checksum;
 }
 
+/*
+ * The trees only need some consistent total order on page contents, not
+ * memcmp's byte order: so compare a word at a time, four words per step,
+ * rather than going through the architecture's bytewise memcmp.
+ */
 static int memcmp_pages(struct page *page1, struct page *page2)
 {
-	char *addr1, *addr2;
-	int ret;
+	unsigned long *addr1, *addr2;
+	int i, ret = 0;
 
 	addr1 = kmap_atomic(page1, KM_USER0);
 	addr2 = kmap_atomic(page2, KM_USER1);
-	ret = memcmp(addr1, addr2, PAGE_SIZE);
+	for (i = 0; i < PAGE_SIZE / sizeof(unsigned long); i += 4) {
+		if (((addr1[i] ^ addr2[i]) | (addr1[i + 1] ^ addr2[i + 1]) |
+		     (addr1[i + 2] ^ addr2[i + 2]) |
+		     (addr1[i + 3] ^ addr2[i + 3])) == 0)
+			continue;
+		while (addr1[i] == addr2[i])
+			i++;
+		ret = addr1[i] < addr2[i] ? -1 : 1;
+		break;
+	}
 	kunmap_atomic(addr2, KM_USER1);
 	kunmap_atomic(addr1, KM_USER0);
 	return ret;
@@ -1152,6 +1213,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	rmap_item->head = stable_node;
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
+	ksm_pages_merged++;
 
 	if (rmap_item->hlist.next)
 		ksm_pages_sharing++;
@@ -1167,14 +1229,15 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  *
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
+ * @checksum: the checksum of the page, as calculated by the scan threads
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item,
+			       unsigned int checksum)
 {
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
 	struct stable_node *stable_node;
 	struct page *kpage;
-	unsigned int checksum;
 	int err;
 
 	remove_rmap_item_from_tree(rmap_item);
@@ -1202,7 +1265,6 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -1272,7 +1334,17 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * scan_get_next_rmap_item - advance the cursor to the next anonymous page
+ * @page: set to the page found, with a reference held
+ * @pending: the caller still holds rmap_items of the current mm
+ *
+ * Returns NULL at the end of a full scan, or at the end of the current mm
+ * while @pending: finishing an mm may free its rmap_items, so the caller
+ * must be done with them first, then call again to move on.
+ */
+static struct rmap_item *scan_get_next_rmap_item(struct page **page,
+						 bool pending)
 {
 	struct mm_struct *mm;
 	struct mm_slot *slot;
@@ -1358,6 +1430,11 @@ next_mm:
 		}
 	}
 
+	if (pending) {
+		up_read(&mm->mmap_sem);
+		return NULL;
+	}
+
 	if (ksm_test_exit(mm)) {
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
@@ -1403,6 +1480,57 @@ next_mm:
 	return NULL;
 }
 
+static inline bool ksm_scan_item_needs_merge(struct ksm_scan_item *item)
+{
+	return !PageKsm(item->page) || !in_stable_tree(item->rmap_item);
+}
+
+static void ksm_scan_checksum(struct ksm_scan_item *items, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (ksm_scan_item_needs_merge(&items[i]))
+			items[i].checksum = calc_checksum(items[i].page);
+}
+
+static void ksm_scan_work(struct work_struct *work)
+{
+	struct ksm_scan_worker *worker = container_of(work,
+					struct ksm_scan_worker, work);
+	u64 start = task_sched_runtime(current);
+
+	ksm_scan_checksum(worker->items, worker->nr);
+	worker->cpu_ns = task_sched_runtime(current) - start;
+}
+
+/*
+ * ksm_scan_checksum_batch - checksum the first @nr pages of the batch,
+ * spread over the scan threads. ksmd takes the first share itself.
+ */
+static void ksm_scan_checksum_batch(int nr)
+{
+	int threads = min_t(int, ksm_scan_threads, nr);
+	int share = DIV_ROUND_UP(nr, threads);
+	int i;
+
+	for (i = 1; i < threads && i * share < nr; i++) {
+		struct ksm_scan_worker *worker = &ksm_scan_workers[i];
+
+		worker->items = &ksm_scan_batch[i * share];
+		worker->nr = min(share, nr - i * share);
+		worker->cpu_ns = 0;
+		queue_work(ksm_scan_wq, &worker->work);
+	}
+
+	ksm_scan_checksum(ksm_scan_batch, min(share, nr));
+
+	while (--i > 0) {
+		flush_work(&ksm_scan_workers[i].work);
+		ksm_scan_cpu_ns += ksm_scan_workers[i].cpu_ns;
+	}
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
@@ -1411,16 +1539,42 @@ static void ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	u64 wall = ktime_to_ns(ktime_get());
+	u64 cpu = task_sched_runtime(current);
+	int nr, i;
 
-	while (scan_npages-- && likely(!freezing(current))) {
-		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
-		if (!rmap_item)
-			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
-		put_page(page);
+	while (scan_npages && likely(!freezing(current))) {
+		for (nr = 0; nr < min_t(unsigned int, scan_npages,
+					KSM_SCAN_BATCH); nr++) {
+			cond_resched();
+			if (unlikely(freezing(current)))
+				break;
+			rmap_item = scan_get_next_rmap_item(&page, nr != 0);
+			if (!rmap_item)
+				break;
+			ksm_scan_batch[nr].page = page;
+			ksm_scan_batch[nr].rmap_item = rmap_item;
+		}
+		if (!nr)
+			break;
+
+		ksm_scan_checksum_batch(nr);
+
+		for (i = 0; i < nr; i++) {
+			struct ksm_scan_item *item = &ksm_scan_batch[i];
+
+			cond_resched();
+			if (ksm_scan_item_needs_merge(item))
+				cmp_and_merge_page(item->page, item->rmap_item,
+						   item->checksum);
+			put_page(item->page);
+		}
+		scan_npages -= nr;
+		ksm_pages_scanned += nr;
 	}
+
+	ksm_scan_wall_ns += ktime_to_ns(ktime_get()) - wall;
+	ksm_scan_cpu_ns += task_sched_runtime(current) - cpu;
 }
 
 static int ksmd_should_run(void)
@@ -1872,6 +2026,32 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t scan_threads_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_scan_threads);
+}
+
+static ssize_t scan_threads_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_threads;
+
+	err = strict_strtoul(buf, 10, &nr_threads);
+	if (err || !nr_threads || nr_threads > KSM_MAX_SCAN_THREADS)
+		return -EINVAL;
+
+	/* don't change the shares under a batch in flight */
+	mutex_lock(&ksm_thread_mutex);
+	ksm_scan_threads = nr_threads;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(scan_threads);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1966,15 +2146,68 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	u64 pages_scanned;
+
+	mutex_lock(&ksm_thread_mutex);
+	pages_scanned = ksm_pages_scanned;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return sprintf(buf, "%llu\n", pages_scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+/* events per second of @ns, working in milliseconds to stay within 64 bits */
+static u64 ksm_rate(u64 events, u64 ns)
+{
+	u64 ms = div64_u64(ns, NSEC_PER_MSEC);
+
+	return ms ? div64_u64(events * MSEC_PER_SEC, ms) : 0;
+}
+
+static ssize_t pages_scanned_per_sec_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	u64 rate;
+
+	mutex_lock(&ksm_thread_mutex);
+	rate = ksm_rate(ksm_pages_scanned, ksm_scan_wall_ns);
+	mutex_unlock(&ksm_thread_mutex);
+
+	return sprintf(buf, "%llu\n", rate);
+}
+KSM_ATTR_RO(pages_scanned_per_sec);
+
+static ssize_t pages_merged_per_cpu_sec_show(struct kobject *kobj,
+					     struct kobj_attribute *attr,
+					     char *buf)
+{
+	u64 rate;
+
+	mutex_lock(&ksm_thread_mutex);
+	rate = ksm_rate(ksm_pages_merged, ksm_scan_cpu_ns);
+	mutex_unlock(&ksm_thread_mutex);
+
+	return sprintf(buf, "%llu\n", rate);
+}
+KSM_ATTR_RO(pages_merged_per_cpu_sec);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&scan_threads_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_scanned_attr.attr,
+	&pages_scanned_per_sec_attr.attr,
+	&pages_merged_per_cpu_sec_attr.attr,
 	NULL,
 };
 
@@ -1987,17 +2220,26 @@ static struct attribute_group ksm_attr_group = {
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
-	int err;
+	int err, i;
 
 	err = ksm_slab_init();
 	if (err)
 		goto out;
 
+	ksm_scan_wq = alloc_workqueue("ksm_scan", WQ_UNBOUND,
+				      KSM_MAX_SCAN_THREADS);
+	if (!ksm_scan_wq) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	for (i = 0; i < KSM_MAX_SCAN_THREADS; i++)
+		INIT_WORK(&ksm_scan_workers[i].work, ksm_scan_work);
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
 		err = PTR_ERR(ksm_thread);
-		goto out_free;
+		goto out_free_wq;
 	}
 
 #ifdef CONFIG_SYSFS
@@ -2005,7 +2247,7 @@ static int __init ksm_init(void)
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
 		kthread_stop(ksm_thread);
-		goto out_free;
+		goto out_free_wq;
 	}
 #else
 	ksm_run = KSM_RUN_MERGE;	/* no way for user to start it */
@@ -2021,6 +2263,8 @@ static int __init ksm_init(void)
 #endif
 	return 0;
 
+out_free_wq:
+	destroy_workqueue(ksm_scan_wq);
 out_free:
 	ksm_slab_free();
 out:
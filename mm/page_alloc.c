@@ -57,6 +57,8 @@
 #include <linux/ftrace_event.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -625,12 +627,18 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			batch_free = to_free;
 
 		do {
+			int mt;
+
 			page = list_entry(list->prev, struct page, lru);
 			/* must delete as __free_one_page list manipulates */
 			list_del(&page->lru);
 			/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
-			__free_one_page(page, zone, 0, page_private(page));
-			trace_mm_page_pcpu_drain(page, 0, page_private(page));
+			mt = page_private(page);
+			/* and CMA pages whose block alloc_contig_range isolated */
+			if (is_migrate_cma(mt))
+				mt = get_pageblock_migratetype(page);
+			__free_one_page(page, zone, 0, mt);
+			trace_mm_page_pcpu_drain(page, 0, mt);
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
@@ -828,11 +836,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA_MIGRATE
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -927,12 +941,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -946,11 +960,13 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * If breaking a large block of pages, move all free
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
-			 * aggressive about taking ownership of free pages
+			 * aggressive about taking ownership of free pages.
+			 * CMA pageblocks are only borrowed, never claimed.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
 					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+					page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -969,7 +985,8 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
@@ -1045,7 +1062,16 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+#ifdef CONFIG_CMA_MIGRATE
+		/*
+		 * Pages borrowed from a CMA pageblock must go back to its
+		 * free list when the pcp lists are drained.
+		 */
+		if (is_migrate_cma(get_pageblock_migratetype(page)))
+			set_page_private(page, MIGRATE_CMA);
+		else
+#endif
+			set_page_private(page, migratetype);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
@@ -1274,7 +1300,8 @@ int split_free_page(struct page *page)
 	set_page_refcounted(page);
 	split_page(page, order);
 
-	if (order >= pageblock_order - 1) {
+	if (order >= pageblock_order - 1 &&
+	    !is_migrate_cma(get_pageblock_migratetype(page))) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
@@ -1346,6 +1373,9 @@ again:
 	zone_statistics(preferred_zone, zone, gfp_flags);
 	local_irq_restore(flags);
 
+	if (order)
+		wakeup_kcompactd(zone, order);
+
 	VM_BUG_ON(bad_range(zone, page));
 	if (prep_new_page(page, order, gfp_flags))
 		goto again;
@@ -4303,6 +4333,10 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->kcompactd_max_order = 0;
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -5526,7 +5560,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE ||
+	    is_migrate_cma(get_pageblock_migratetype(page)))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5636,7 +5671,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5644,12 +5679,199 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA_MIGRATE
+/*
+ * Hand a pageblock of a migratable CMA region, reserved at boot, over
+ * to the buddy allocator.  Only movable allocations will use it.
+ */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+#ifdef CONFIG_HIGHMEM
+	if (PageHighMem(page))
+		totalhigh_pages += pageblock_nr_pages;
+#endif
+}
+
+#define NR_CONTIG_MIGRATE_AT_ONCE	32
+#define CONTIG_MIGRATE_RETRIES		5
+
+static struct page *
+alloc_contig_migrate_alloc(struct page *page, unsigned long private,
+			   int **resultp)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/*
+ * Migrate the pages on the LRU in [start, end) elsewhere.  Pages not on
+ * the LRU are skipped; whether the range ended up free is checked later.
+ */
+static int alloc_contig_migrate_range(unsigned long start, unsigned long end)
+{
+	unsigned long pfn = start;
+	struct page *page;
+	LIST_HEAD(source);
+	int nr;
+
+	while (pfn < end) {
+		if (fatal_signal_pending(current))
+			return -EINTR;
+
+		for (nr = 0; pfn < end && nr < NR_CONTIG_MIGRATE_AT_ONCE;
+		     pfn++) {
+			if (!pfn_valid_within(pfn))
+				continue;
+			page = pfn_to_page(pfn);
+			if (!get_page_unless_zero(page))
+				continue;
+			if (!isolate_lru_page(page)) {
+				list_add_tail(&page->lru, &source);
+				inc_zone_page_state(page, NR_ISOLATED_ANON +
+						    page_is_file_cache(page));
+				nr++;
+			}
+			put_page(page);
+		}
+
+		if (!list_empty(&source) &&
+		    migrate_pages(&source, alloc_contig_migrate_alloc, 0,
+				  true, true))
+			putback_lru_pages(&source);
+	}
+	return 0;
+}
+
+/*
+ * Take the free pages covering [start, end) off the free lists, or fail
+ * with -EBUSY if any page in the range is still in use.  The pageblocks
+ * around the range must be isolated.  On success [*outer_start,
+ * *outer_end) is the range taken, every page in it with a count of 1.
+ */
+static int take_contig_free_range(struct zone *zone, unsigned long start,
+				  unsigned long end, unsigned long *outer_start,
+				  unsigned long *outer_end)
+{
+	unsigned long flags, pfn;
+	struct page *page;
+	unsigned int order;
+	int ret = -EBUSY;
+
+	spin_lock_irqsave(&zone->lock, flags);
+
+	/* The free page holding start may begin before it */
+	for (order = 0; order < MAX_ORDER; order++) {
+		pfn = start & ~((1UL << order) - 1);
+		page = pfn_to_page(pfn);
+		if (PageBuddy(page) && pfn + (1UL << page_order(page)) > start)
+			break;
+	}
+	if (order == MAX_ORDER)
+		goto out;
+	*outer_start = pfn;
+
+	while (pfn < end) {
+		page = pfn_to_page(pfn);
+		if (!PageBuddy(page))
+			goto out;
+		pfn += 1UL << page_order(page);
+	}
+	*outer_end = pfn;
+
+	for (pfn = *outer_start; pfn < *outer_end; pfn += 1UL << order) {
+		page = pfn_to_page(pfn);
+		order = page_order(page);
+		list_del(&page->lru);
+		zone->free_area[order].nr_free--;
+		rmv_page_order(page);
+		set_page_refcounted(page);
+		split_page(page, order);
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES,
+			      -(long)(*outer_end - *outer_start));
+	ret = 0;
+out:
+	spin_unlock_irqrestore(&zone->lock, flags);
+	return ret;
+}
+
+/**
+ * alloc_contig_range() -- allocate the pages of a migratable CMA range
+ * @start:	first PFN to allocate
+ * @end:	one past the last PFN to allocate
+ *
+ * Isolates the pageblocks around the range, migrates the movable pages
+ * borrowed from it elsewhere and takes the then free pages off the free
+ * lists.  The range must lie in MIGRATE_CMA pageblocks of a single zone.
+ * Returns 0 with each page in the range allocated, -EBUSY if some page
+ * could not be moved out of the way, or -EINTR.
+ */
+int alloc_contig_range(unsigned long start, unsigned long end)
+{
+	struct zone *zone = page_zone(pfn_to_page(start));
+	unsigned long iso_start, iso_end, outer_start, outer_end, pfn;
+	int tries = 0, ret;
+
+	iso_start = start & ~(max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				  pageblock_nr_pages) - 1);
+	iso_end = ALIGN(end, max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				  pageblock_nr_pages));
+
+	ret = start_isolate_page_range(iso_start, iso_end, MIGRATE_CMA);
+	if (ret)
+		return ret;
+
+	migrate_prep();
+	do {
+		ret = alloc_contig_migrate_range(start, end);
+		if (ret)
+			goto done;
+		/* Flush pages just freed on other CPUs back to the buddy */
+		lru_add_drain_all();
+		drain_all_pages();
+		ret = take_contig_free_range(zone, start, end,
+					     &outer_start, &outer_end);
+	} while (ret && ++tries < CONTIG_MIGRATE_RETRIES);
+	if (ret)
+		goto done;
+
+	/* Give back what the free pages held outside of the range */
+	free_contig_range(outer_start, start - outer_start);
+	free_contig_range(end, outer_end - end);
+
+	for (pfn = start; pfn < end; pfn++) {
+		arch_alloc_page(pfn_to_page(pfn), 0);
+		kernel_map_pages(pfn_to_page(pfn), 1, 1);
+	}
+done:
+	undo_isolate_page_range(iso_start, iso_end, MIGRATE_CMA);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned long nr_pages)
+{
+	for (; nr_pages--; pfn++)
+		__free_page(pfn_to_page(pfn));
+}
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
@@ -0,0 +1,555 @@
+/*
+ * mm/prefetch_trace.c
+ *
+ * Records which file pages had to be read from storage during a window,
+ * such as boot or an application launch, and replays the recording later
+ * as large sequential reads so that the same window finds them cached.
+ *
+ * Controlled through debugfs, in <debugfs>/prefetch/:
+ *
+ *   control	write "record", "stop", "replay" or "clear"; reads back
+ *		the current state
+ *   trace	the recorded trace, one "<start> <pages> <path>" line per
+ *		range of a file; writing lines in the same format imports
+ *		a trace saved from an earlier boot
+ *   report	how long recording and the last replay took
+ *
+ * Booting with "prefetch_record" starts recording from the first read.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/list_sort.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/path.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include "internal.h"
+
+#define PREFETCH_HASH_BITS	8
+#define PREFETCH_MAX_RANGES	32768
+/*
+ * Misses this close to the end of the last range extend it: reading a
+ * few pages that were not asked for is cheaper than another request.
+ */
+#define PREFETCH_MERGE_GAP	16
+
+enum {
+	PREFETCH_IDLE,
+	PREFETCH_RECORDING,
+	PREFETCH_REPLAYING,
+};
+
+static const char * const prefetch_state_names[] = {
+	[PREFETCH_IDLE]		= "idle",
+	[PREFETCH_RECORDING]	= "recording",
+	[PREFETCH_REPLAYING]	= "replaying",
+};
+
+struct prefetch_range {
+	struct list_head list;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct prefetch_file {
+	struct list_head list;
+	struct list_head ranges;
+	/* While recording: the file, and the range misses go to first */
+	struct hlist_node hash;
+	struct inode *inode;
+	struct path path;
+	struct prefetch_range *last;
+	/* Once recording stopped, or for an imported trace */
+	char *name;
+};
+
+bool prefetch_trace_recording __read_mostly;
+static int prefetch_state;
+
+/* Serialises control operations, import and export */
+static DEFINE_MUTEX(prefetch_mutex);
+/* Protects the trace against the recording hook */
+static DEFINE_SPINLOCK(prefetch_lock);
+
+static LIST_HEAD(prefetch_files);
+static struct hlist_head prefetch_hash[1 << PREFETCH_HASH_BITS];
+
+static struct {
+	unsigned int files;
+	unsigned int ranges;
+	unsigned long pages;
+	unsigned long dropped;
+	unsigned long start;
+	unsigned int msecs;
+} record_stats;
+
+static struct {
+	unsigned int files;
+	unsigned int missing;
+	unsigned long pages;
+	unsigned long read;
+	unsigned int msecs;
+} replay_stats;
+
+static struct prefetch_file *prefetch_lookup(struct inode *inode)
+{
+	struct hlist_head *head;
+	struct hlist_node *node;
+	struct prefetch_file *pf;
+
+	head = &prefetch_hash[hash_ptr(inode, PREFETCH_HASH_BITS)];
+	hlist_for_each_entry(pf, node, head, hash)
+		if (pf->inode == inode)
+			return pf;
+	return NULL;
+}
+
+static struct prefetch_file *prefetch_file_alloc(gfp_t gfp)
+{
+	struct prefetch_file *pf;
+
+	pf = kzalloc(sizeof(*pf), gfp);
+	if (pf) {
+		INIT_LIST_HEAD(&pf->ranges);
+		INIT_HLIST_NODE(&pf->hash);
+	}
+	return pf;
+}
+
+static struct prefetch_range *prefetch_range_add(struct prefetch_file *pf,
+		pgoff_t start, unsigned long nr, gfp_t gfp)
+{
+	struct prefetch_range *r;
+
+	if (record_stats.ranges >= PREFETCH_MAX_RANGES)
+		return NULL;
+	r = kmalloc(sizeof(*r), gfp);
+	if (!r)
+		return NULL;
+	r->start = start;
+	r->nr = nr;
+	list_add_tail(&r->list, &pf->ranges);
+	record_stats.ranges++;
+	return r;
+}
+
+/*
+ * Called for pages about to be read into the page cache of @filp.  Only
+ * reached while prefetch_trace_recording is set.
+ */
+void __prefetch_trace_record(struct file *filp, pgoff_t index,
+			     unsigned long nr)
+{
+	struct inode *inode = filp->f_mapping->host;
+	struct prefetch_file *pf;
+	struct prefetch_range *r;
+
+	if (!S_ISREG(inode->i_mode))
+		return;
+
+	spin_lock(&prefetch_lock);
+	if (prefetch_state != PREFETCH_RECORDING)
+		goto out;
+
+	pf = prefetch_lookup(inode);
+	if (!pf) {
+		pf = prefetch_file_alloc(GFP_ATOMIC);
+		if (!pf)
+			goto drop;
+		pf->inode = inode;
+		pf->path = filp->f_path;
+		path_get(&pf->path);
+		hlist_add_head(&pf->hash, &prefetch_hash[hash_ptr(inode,
+						PREFETCH_HASH_BITS)]);
+		list_add_tail(&pf->list, &prefetch_files);
+		record_stats.files++;
+	}
+
+	r = pf->last;
+	if (r && index >= r->start &&
+	    index <= r->start + r->nr + PREFETCH_MERGE_GAP) {
+		r->nr = max(r->nr, index + nr - r->start);
+	} else {
+		r = prefetch_range_add(pf, index, nr, GFP_ATOMIC);
+		if (!r)
+			goto drop;
+		pf->last = r;
+	}
+	record_stats.pages += nr;
+out:
+	spin_unlock(&prefetch_lock);
+	return;
+drop:
+	record_stats.dropped += nr;
+	spin_unlock(&prefetch_lock);
+}
+
+static int prefetch_range_cmp(void *priv, struct list_head *a,
+			      struct list_head *b)
+{
+	struct prefetch_range *ra = list_entry(a, struct prefetch_range, list);
+	struct prefetch_range *rb = list_entry(b, struct prefetch_range, list);
+
+	if (ra->start < rb->start)
+		return -1;
+	return ra->start > rb->start;
+}
+
+/* Sort the ranges of a file and merge those that overlap or touch */
+static void prefetch_merge_ranges(struct prefetch_file *pf)
+{
+	struct prefetch_range *r, *next, *prev = NULL;
+
+	list_sort(NULL, &pf->ranges, prefetch_range_cmp);
+	list_for_each_entry_safe(r, next, &pf->ranges, list) {
+		if (prev && r->start <= prev->start + prev->nr +
+				PREFETCH_MERGE_GAP) {
+			prev->nr = max(prev->nr, r->start + r->nr - prev->start);
+			list_del(&r->list);
+			kfree(r);
+			record_stats.ranges--;
+			continue;
+		}
+		prev = r;
+	}
+}
+
+static void prefetch_file_free(struct prefetch_file *pf)
+{
+	struct prefetch_range *r, *next;
+
+	list_for_each_entry_safe(r, next, &pf->ranges, list) {
+		kfree(r);
+		record_stats.ranges--;
+	}
+	if (pf->inode)
+		path_put(&pf->path);
+	kfree(pf->name);
+	kfree(pf);
+}
+
+/* Called with prefetch_mutex held, once recording is off */
+static void prefetch_clear(void)
+{
+	struct prefetch_file *pf, *next;
+
+	list_for_each_entry_safe(pf, next, &prefetch_files, list)
+		prefetch_file_free(pf);
+	INIT_LIST_HEAD(&prefetch_files);
+	memset(prefetch_hash, 0, sizeof(prefetch_hash));
+	memset(&record_stats, 0, sizeof(record_stats));
+}
+
+static void prefetch_start_recording(void)
+{
+	spin_lock(&prefetch_lock);
+	record_stats.start = jiffies;
+	prefetch_state = PREFETCH_RECORDING;
+	prefetch_trace_recording = true;
+	spin_unlock(&prefetch_lock);
+}
+
+/*
+ * Stop recording and turn what was recorded into path names, dropping
+ * the references that kept them valid, so that the trace can be saved.
+ */
+static void prefetch_stop_recording(void)
+{
+	struct prefetch_file *pf, *next;
+	char *buf, *name;
+
+	spin_lock(&prefetch_lock);
+	prefetch_trace_recording = false;
+	prefetch_state = PREFETCH_IDLE;
+	record_stats.msecs = jiffies_to_msecs(jiffies - record_stats.start);
+	spin_unlock(&prefetch_lock);
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	list_for_each_entry_safe(pf, next, &prefetch_files, list) {
+		if (!pf->inode)
+			continue;
+		name = NULL;
+		if (buf && !d_unlinked(pf->path.dentry)) {
+			name = d_path(&pf->path, buf, PAGE_SIZE);
+			/* The trace is line based */
+			if (IS_ERR(name) || strchr(name, '\n'))
+				name = NULL;
+		}
+		if (name)
+			pf->name = kstrdup(name, GFP_KERNEL);
+		hlist_del_init(&pf->hash);
+		path_put(&pf->path);
+		pf->inode = NULL;
+		pf->last = NULL;
+		if (!pf->name) {
+			record_stats.files--;
+			list_del(&pf->list);
+			prefetch_file_free(pf);
+			continue;
+		}
+		prefetch_merge_ranges(pf);
+	}
+	if (buf)
+		free_page((unsigned long)buf);
+}
+
+static void prefetch_replay(void)
+{
+	struct prefetch_file *pf;
+	struct prefetch_range *r;
+	unsigned long start = jiffies;
+	struct file *filp;
+	int ret;
+
+	memset(&replay_stats, 0, sizeof(replay_stats));
+	prefetch_state = PREFETCH_REPLAYING;
+
+	list_for_each_entry(pf, &prefetch_files, list) {
+		filp = filp_open(pf->name, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(filp)) {
+			replay_stats.missing++;
+			continue;
+		}
+		replay_stats.files++;
+		list_for_each_entry(r, &pf->ranges, list) {
+			/* Pages already cached are skipped, not reread */
+			ret = force_page_cache_readahead(filp->f_mapping, filp,
+							 r->start, r->nr);
+			replay_stats.pages += r->nr;
+			if (ret > 0)
+				replay_stats.read += ret;
+		}
+		filp_close(filp, NULL);
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	replay_stats.msecs = jiffies_to_msecs(jiffies - start);
+	prefetch_state = PREFETCH_IDLE;
+}
+
+static ssize_t prefetch_control_read(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	char buf[16];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%s\n",
+		       prefetch_state_names[prefetch_state]);
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static ssize_t prefetch_control_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char buf[16];
+	int ret = count;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	mutex_lock(&prefetch_mutex);
+	if (sysfs_streq(buf, "record")) {
+		if (prefetch_state == PREFETCH_IDLE) {
+			prefetch_clear();
+			prefetch_start_recording();
+		} else
+			ret = -EBUSY;
+	} else if (sysfs_streq(buf, "stop")) {
+		if (prefetch_state == PREFETCH_RECORDING)
+			prefetch_stop_recording();
+	} else if (sysfs_streq(buf, "replay")) {
+		if (prefetch_state == PREFETCH_IDLE)
+			prefetch_replay();
+		else
+			ret = -EBUSY;
+	} else if (sysfs_streq(buf, "clear")) {
+		if (prefetch_state == PREFETCH_IDLE)
+			prefetch_clear();
+		else
+			ret = -EBUSY;
+	} else
+		ret = -EINVAL;
+	mutex_unlock(&prefetch_mutex);
+
+	return ret;
+}
+
+static const struct file_operations prefetch_control_fops = {
+	.read		= prefetch_control_read,
+	.write		= prefetch_control_write,
+	.llseek		= default_llseek,
+};
+
+/* The trace is empty while recording: names are only known once stopped */
+static void *prefetch_trace_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&prefetch_mutex);
+	if (prefetch_state == PREFETCH_RECORDING)
+		return NULL;
+	return seq_list_start(&prefetch_files, *pos);
+}
+
+static void *prefetch_trace_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &prefetch_files, pos);
+}
+
+static void prefetch_trace_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&prefetch_mutex);
+}
+
+static int prefetch_trace_show(struct seq_file *m, void *v)
+{
+	struct prefetch_file *pf = list_entry(v, struct prefetch_file, list);
+	struct prefetch_range *r;
+
+	list_for_each_entry(r, &pf->ranges, list)
+		seq_printf(m, "%lu %lu %s\n", r->start, r->nr, pf->name);
+	return 0;
+}
+
+static const struct seq_operations prefetch_trace_sops = {
+	.start	= prefetch_trace_start,
+	.next	= prefetch_trace_next,
+	.stop	= prefetch_trace_stop,
+	.show	= prefetch_trace_show,
+};
+
+static int prefetch_trace_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &prefetch_trace_sops);
+}
+
+/* Called with prefetch_mutex held */
+static int prefetch_import_line(char *line, void *data)
+{
+	struct prefetch_file *pf = NULL;
+	unsigned long start, nr;
+	int n = 0;
+
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &n) != 2 || !n ||
+	    line[n] != '/' || !nr)
+		return -EINVAL;
+	line += n;
+
+	/* A trace lists the ranges of each file together */
+	if (!list_empty(&prefetch_files)) {
+		pf = list_entry(prefetch_files.prev, struct prefetch_file, list);
+		if (strcmp(pf->name, line))
+			pf = NULL;
+	}
+	if (!pf) {
+		pf = prefetch_file_alloc(GFP_KERNEL);
+		if (!pf)
+			return -ENOMEM;
+		pf->name = kstrdup(line, GFP_KERNEL);
+		if (!pf->name) {
+			kfree(pf);
+			return -ENOMEM;
+		}
+		list_add_tail(&pf->list, &prefetch_files);
+		record_stats.files++;
+	}
+
+	if (!prefetch_range_add(pf, start, nr, GFP_KERNEL))
+		return -ENOSPC;
+	record_stats.pages += nr;
+	return 0;
+}
+
+static ssize_t prefetch_trace_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&prefetch_mutex);
+	if (prefetch_state != PREFETCH_IDLE)
+		ret = -EBUSY;
+	else
+		ret = simple_write_lines(ubuf, count, prefetch_import_line,
+					 NULL);
+	mutex_unlock(&prefetch_mutex);
+	return ret;
+}
+
+static const struct file_operations prefetch_trace_fops = {
+	.open		= prefetch_trace_open,
+	.read		= seq_read,
+	.write		= prefetch_trace_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int prefetch_report_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "state:    %s\n", prefetch_state_names[prefetch_state]);
+	seq_printf(m, "recorded: %u files, %u ranges, %lu pages "
+		   "(%lu dropped) in %u ms\n",
+		   record_stats.files, record_stats.ranges, record_stats.pages,
+		   record_stats.dropped, record_stats.msecs);
+	seq_printf(m, "replayed: %u files (%u missing), %lu of %lu pages "
+		   "read in %u ms\n",
+		   replay_stats.files, replay_stats.missing, replay_stats.read,
+		   replay_stats.pages, replay_stats.msecs);
+	return 0;
+}
+
+static int prefetch_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, prefetch_report_show, NULL);
+}
+
+static const struct file_operations prefetch_report_fops = {
+	.open		= prefetch_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init prefetch_record_setup(char *str)
+{
+	prefetch_start_recording();
+	return 1;
+}
+__setup("prefetch_record", prefetch_record_setup);
+
+static int __init prefetch_trace_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("prefetch", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("control", 0600, dir, NULL,
+				 &prefetch_control_fops) ||
+	    !debugfs_create_file("trace", 0600, dir, NULL,
+				 &prefetch_trace_fops) ||
+	    !debugfs_create_file("report", 0400, dir, NULL,
+				 &prefetch_report_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+	return 0;
+}
+late_initcall(prefetch_trace_init);
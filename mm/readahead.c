@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include "internal.h"
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -187,6 +188,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		prefetch_trace_record(filp, page_offset, 1);
 		ret++;
 	}
 
@@ -251,14 +253,125 @@ unsigned long max_sane_readahead(unsigned long nr)
 unsigned long ra_submit(struct file_ra_state *ra,
 		       struct address_space *mapping, struct file *filp)
 {
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
 	int actual;
 
 	actual = __do_page_cache_readahead(mapping, filp,
 					ra->start, ra->size, ra->async_size);
 
+	if (bdi->ra_adaptive && actual > 0) {
+		/* Remember the window, to be judged once the reader is past */
+		if (ra->win_size && ra->win_start + ra->win_size == ra->start)
+			ra->win_size += ra->size;
+		else {
+			ra->win_start = ra->start;
+			ra->win_size = ra->size;
+		}
+		add_bdi_stat(bdi, BDI_RA_PAGES, actual);
+	}
+
 	return actual;
 }
 
+/*
+ * Adaptive readahead.
+ *
+ * The ramp-up heuristics below assume a disk where reading more costs
+ * little once the head is there.  On flash, pages read ahead for random
+ * mmap faults are mostly wasted, while long streams want larger windows
+ * than the default.  When enabled on the backing device, each file keeps
+ * a count of the pages read ahead that were used (referenced, activated
+ * or mapped) by the time the reader moved past them and of those that
+ * were not, and the readahead window limit is scaled by that hit rate.
+ */
+#define RA_HISTORY_MIN		16	/* pages judged before adapting */
+#define RA_HISTORY_MAX		256	/* history is halved beyond this */
+#define RA_ADAPT_MIN		4	/* smallest window limit */
+
+static void ra_judge_window(struct address_space *mapping,
+			    struct file_ra_state *ra, pgoff_t offset)
+{
+	pgoff_t index = ra->win_start;
+	pgoff_t end = ra->win_start + ra->win_size;
+	unsigned int used = 0, unused = 0;
+	struct pagevec pvec;
+	int i;
+
+	/* Only judge the pages the reader has moved past */
+	if (offset > index && offset < end)
+		end = offset;
+
+	pagevec_init(&pvec, 0);
+	while (index < end && pagevec_lookup(&pvec, mapping, index,
+				min_t(pgoff_t, end - index, PAGEVEC_SIZE))) {
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			struct page *page = pvec.pages[i];
+
+			index = page->index + 1;
+			if (page->index >= end)
+				break;
+			if (PageReferenced(page) || PageActive(page) ||
+			    page_mapped(page))
+				used++;
+			else
+				unused++;
+		}
+		pagevec_release(&pvec);
+	}
+
+	if (end < ra->win_start + ra->win_size) {
+		ra->win_size -= end - ra->win_start;
+		ra->win_start = end;
+	} else
+		ra->win_size = 0;
+
+	ra->hits += used;
+	ra->misses += unused;
+	if (ra->hits + ra->misses > RA_HISTORY_MAX) {
+		ra->hits /= 2;
+		ra->misses /= 2;
+	}
+	add_bdi_stat(mapping->backing_dev_info, BDI_RA_HIT, used);
+	add_bdi_stat(mapping->backing_dev_info, BDI_RA_MISS, unused);
+}
+
+/**
+ * ra_adapt_max - scale the readahead window limit by the hit rate
+ * @mapping: address_space the read is against
+ * @ra: file_ra_state of the reader
+ * @offset: page the reader is at
+ * @max: readahead window limit
+ *
+ * Judges what the reader made of the pages read ahead so far, and
+ * returns @max scaled by the file's readahead hit rate: doubled when
+ * nearly everything read ahead gets used, shrunk towards a few pages
+ * when less than half is.  Returns @max unchanged unless adaptive
+ * readahead is enabled for the backing device.
+ */
+unsigned long ra_adapt_max(struct address_space *mapping,
+			   struct file_ra_state *ra,
+			   pgoff_t offset, unsigned long max)
+{
+	unsigned int total, rate;
+
+	if (!mapping->backing_dev_info->ra_adaptive)
+		return max;
+
+	if (ra->win_size)
+		ra_judge_window(mapping, ra, offset);
+
+	total = ra->hits + ra->misses;
+	if (total < RA_HISTORY_MIN)
+		return max;
+
+	rate = ra->hits * 100 / total;
+	if (rate >= 90)
+		return max * 2;
+	if (rate >= 50)
+		return max;
+	return max_t(unsigned long, max * rate / 50, RA_ADAPT_MIN);
+}
+
 /*
  * Set the initial window size, round to next power of 2 and square
  * for small size, x 4 for medium, and x 2 for large
@@ -398,7 +511,8 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
-	unsigned long max = max_sane_readahead(ra->ra_pages);
+	unsigned long max = max_sane_readahead(ra_adapt_max(mapping, ra,
+						offset, ra->ra_pages));
 
 	/*
 	 * start of file
@@ -1180,6 +1180,7 @@ static struct page *shmem_swapin(swp_entry_t entry, gfp_t gfp,
 	pvma.vm_pgoff = idx;
 	pvma.vm_ops = NULL;
 	pvma.vm_policy = spol;
+	pvma.vm_mm = NULL;	/* no page table to read ahead by */
 	page = swapin_readahead(entry, gfp, &pvma, 0);
 	return page;
 }
@@ -0,0 +1,98 @@
+/*
+ * mm/slab-bulk-bench.c
+ *
+ * Compares the cost per object of kmem_cache_alloc_bulk() and
+ * kmem_cache_free_bulk() with the single object calls, for a range of
+ * batch sizes.  Results go to the kernel log when the module is loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+
+#define BENCH_MAX_BULK	128
+
+static unsigned int loops = 100000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Batches allocated and freed per measurement");
+
+static unsigned int object_size = 256;
+module_param(object_size, uint, 0444);
+MODULE_PARM_DESC(object_size, "Size of the objects in the test cache");
+
+static void *objs[BENCH_MAX_BULK];
+
+/* Nanoseconds per object for a batch size, one object at a time */
+static u64 bench_single(struct kmem_cache *s, unsigned int bulk)
+{
+	ktime_t start = ktime_get();
+	unsigned int n, i;
+
+	for (n = 0; n < loops; n++) {
+		for (i = 0; i < bulk; i++) {
+			objs[i] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[i])
+				break;
+		}
+		while (i--)
+			kmem_cache_free(s, objs[i]);
+		cond_resched();
+	}
+	return div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		       loops * bulk);
+}
+
+/* Nanoseconds per object for a batch size, through the bulk interface */
+static u64 bench_bulk(struct kmem_cache *s, unsigned int bulk)
+{
+	ktime_t start = ktime_get();
+	unsigned int n;
+
+	for (n = 0; n < loops; n++) {
+		if (kmem_cache_alloc_bulk(s, GFP_KERNEL, bulk, objs))
+			kmem_cache_free_bulk(s, bulk, objs);
+		cond_resched();
+	}
+	return div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		       loops * bulk);
+}
+
+static int __init slab_bulk_bench_init(void)
+{
+	struct kmem_cache *s;
+	unsigned int bulk;
+
+	if (!loops)
+		return -EINVAL;
+
+	s = kmem_cache_create("slab_bulk_bench", object_size, 0, 0, NULL);
+	if (!s)
+		return -ENOMEM;
+
+	pr_info("slab_bulk_bench: %u byte objects, %u loops\n",
+		object_size, loops);
+	for (bulk = 1; bulk <= BENCH_MAX_BULK; bulk *= 2)
+		pr_info("slab_bulk_bench: bulk %3u: single %llu ns, "
+			"bulk %llu ns per object\n", bulk,
+			(unsigned long long)bench_single(s, bulk),
+			(unsigned long long)bench_bulk(s, bulk));
+
+	kmem_cache_destroy(s);
+	return 0;
+}
+module_init(slab_bulk_bench_init);
+
+static void __exit slab_bulk_bench_exit(void)
+{
+}
+module_exit(slab_bulk_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Slab bulk allocation microbenchmark");
@@ -2149,6 +2149,99 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * Bulk allocation and freeing work on the per cpu freelist directly with
+ * interrupts disabled once for the whole batch, instead of paying for a
+ * cmpxchg per object.  The tid is advanced before anything that may let
+ * other code run on this cpu and at the end, so that lockless fastpath
+ * operations that raced with the batch retry.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t nr,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	size_t i;
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	local_irq_save(irqflags);
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < nr; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			c->tid = next_tid(c->tid);
+			/* May enable interrupts and sleep for a new slab */
+			p[i] = __slab_alloc(s, flags, NUMA_NO_NODE, _RET_IP_, c);
+			if (unlikely(!p[i]))
+				goto error;
+			c = this_cpu_ptr(s->cpu_slab);
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[i] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_restore(irqflags);
+
+	for (i = 0; i < nr; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->objsize);
+		slab_post_alloc_hook(s, flags, p[i]);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->objsize, s->size,
+				       flags);
+	}
+	return nr;
+
+error:
+	c = this_cpu_ptr(s->cpu_slab);
+	c->tid = next_tid(c->tid);
+	local_irq_restore(irqflags);
+	while (i--) {
+		slab_post_alloc_hook(s, flags, p[i]);
+		slab_free(s, virt_to_head_page(p[i]), p[i], _RET_IP_);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t nr, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		slab_free_hook(s, p[i]);
+
+	local_irq_save(irqflags);
+	c = this_cpu_ptr(s->cpu_slab);
+
+	for (i = 0; i < nr; i++) {
+		void **object = p[i];
+		struct page *page = virt_to_head_page(object);
+
+		if (unlikely(page != c->page)) {
+			c->tid = next_tid(c->tid);
+			__slab_free(s, page, object, _RET_IP_);
+			continue;
+		}
+		set_freepointer(s, object, c->freelist);
+		c->freelist = object;
+		stat(s, FREE_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_restore(irqflags);
+
+	for (i = 0; i < nr; i++)
+		trace_kmem_cache_free(_RET_IP_, p[i]);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /*
  * Object placement in a slab is made very easy because we always start at
  * offset 0. If we tune the size of the object to the alignment then we can
@@ -266,8 +266,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		/* A page read ahead was wanted after all */
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			atomic_inc(&swp_swap_info(entry)->ra_hits);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -352,6 +358,147 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Read ahead one swap entry, unless it is in the swap cache already.
+ * Pages read are marked, so that lookup_swap_cache() can tell whether
+ * reading them was worth it.  Returns false if memory ran out.
+ */
+static bool swapin_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+
+	page = find_get_page(&swapper_space, entry.val);
+	if (page) {
+		page_cache_release(page);
+		return true;
+	}
+
+	page = read_swap_cache_async(entry, gfp_mask, vma, addr);
+	if (!page)
+		return false;
+	SetPageReadahead(page);
+	count_vm_event(SWAP_RA);
+	page_cache_release(page);
+	return true;
+}
+
+/* Largest window read by page table locality, to keep it on the stack */
+#define SWAP_RA_VMA_MAX		32
+
+/*
+ * Window for a device where slots are cheap to read one at a time, so
+ * that its neighbours are only worth reading if they are used: it grows
+ * with the readahead pages faulted in since the last read and shrinks
+ * without, down to no readahead.  @key is the offset or address read,
+ * which lets sequential access open the window before any hit.
+ */
+static unsigned int swapin_nr_pages(struct swap_info_struct *si,
+				    unsigned long key, unsigned int max_pages)
+{
+	unsigned int pages, last_ra;
+
+	if (max_pages <= 1)
+		return 1;
+
+	pages = atomic_xchg(&si->ra_hits, 0) + 2;
+	if (pages == 2) {
+		/* No hits to judge by: read ahead only when sequential */
+		if (key != si->ra_prev + 1 && key != si->ra_prev - 1)
+			pages = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+	si->ra_prev = key;
+
+	/* Don't shrink the window too fast */
+	last_ra = si->ra_pages / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+
+	/* The window may have grown under a larger max_pages */
+	if (pages > max_pages)
+		pages = max_pages;
+	si->ra_pages = pages;
+
+	return pages;
+}
+
+/*
+ * Read the swap entries mapped around @addr in @vma: on a device with
+ * no seek cost, pages that were neighbours in memory are far more
+ * likely to be needed together than pages that were neighbours in swap.
+ * Returns false if there was no page table to go by.
+ */
+static bool swapin_readahead_vma(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct swap_info_struct *si = swp_swap_info(entry);
+	swp_entry_t entries[SWAP_RA_VMA_MAX];
+	unsigned long start, end, pos;
+	unsigned int nr_pages, max_pages, i;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	if (!vma || !vma->vm_mm)
+		return false;
+
+	max_pages = min(1 << page_cluster, SWAP_RA_VMA_MAX);
+	nr_pages = swapin_nr_pages(si, addr >> PAGE_SHIFT, max_pages);
+	if (nr_pages <= 1)
+		return true;
+
+	/* Aligned window, within the vma and the page table of @addr */
+	start = addr & ~((unsigned long)nr_pages * PAGE_SIZE - 1);
+	end = start + nr_pages * PAGE_SIZE;
+	start = max3(start, vma->vm_start, addr & PMD_MASK);
+	end = min3(end, vma->vm_end, (addr & PMD_MASK) + PMD_SIZE);
+
+	pgd = pgd_offset(vma->vm_mm, start);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		return true;
+	pud = pud_offset(pgd, start);
+	if (pud_none(*pud) || pud_bad(*pud))
+		return true;
+	pmd = pmd_offset(pud, start);
+	if (pmd_none(*pmd) || pmd_trans_huge(*pmd) || pmd_bad(*pmd))
+		return true;
+
+	/*
+	 * Copy the entries out: reading sleeps.  They are checked again
+	 * when read, so it does not matter if they change under us.
+	 */
+	pte = pte_offset_map(pmd, start);
+	for (i = 0, pos = start; pos < end && i < SWAP_RA_VMA_MAX;
+	     pos += PAGE_SIZE, i++) {
+		pte_t ptent = pte[i];
+
+		entries[i].val = 0;
+		if (!is_swap_pte(ptent))
+			continue;
+		entries[i] = pte_to_swp_entry(ptent);
+		if (non_swap_entry(entries[i]))
+			entries[i].val = 0;
+	}
+	pte_unmap(pte);
+
+	for (i = 0, pos = start; pos < end && i < SWAP_RA_VMA_MAX;
+	     pos += PAGE_SIZE, i++) {
+		if (!entries[i].val || entries[i].val == entry.val)
+			continue;
+		if (!swapin_readahead_one(entries[i], gfp_mask, vma, pos))
+			break;
+	}
+
+	return true;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -361,10 +508,14 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  *
  * Returns the struct page for entry and addr, after queueing swapin.
  *
- * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * How much to read ahead depends on the swap device.  On a disk we
+ * simply read an aligned block of (1 << page_cluster) entries in the
+ * swap area.  This method is chosen because it doesn't cost us any seek
+ * time.  On a device without seeks, flash or zram, where each extra page
+ * costs a read or a decompression of its own, we read the pages mapped
+ * around @addr instead, and only as many as recent readahead hits say
+ * are used.  We also make sure to queue the 'original' request together
+ * with the readahead ones...
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -374,11 +525,19 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
-	int nr_pages;
-	struct page *page;
+	struct swap_info_struct *si = swp_swap_info(entry);
+	int nr_pages, cluster = page_cluster;
 	unsigned long offset;
 	unsigned long end_offset;
 
+	if (si->flags & SWP_SOLIDSTATE) {
+		if (swapin_readahead_vma(entry, gfp_mask, vma, addr))
+			goto read;
+		/* No page tables (shmem): adaptive window in swap instead */
+		cluster = ilog2(swapin_nr_pages(si, swp_offset(entry),
+						1 << page_cluster));
+	}
+
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
 	 * Adjust starting address by readbehind (for NUMA interleave case)?
@@ -386,15 +545,23 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 * more likely that neighbouring swap pages came from the same node:
 	 * so use the same "addr" to choose the same node for each swap read.
 	 */
-	nr_pages = valid_swaphandles(entry, &offset);
+	nr_pages = valid_swaphandles(entry, &offset, cluster);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		swp_entry_t ra_entry = swp_entry(swp_type(entry), offset);
+
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
+		if (offset == swp_offset(entry)) {
+			/* In order, but not to be counted as read ahead */
+			struct page *page = read_swap_cache_async(ra_entry,
 						gfp_mask, vma, addr);
-		if (!page)
+			if (!page)
+				break;
+			page_cache_release(page);
+		} else if (!swapin_readahead_one(ra_entry, gfp_mask,
+						 vma, addr))
 			break;
-		page_cache_release(page);
 	}
+read:
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
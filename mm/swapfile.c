@@ -1868,6 +1868,8 @@ static struct swap_info_struct *alloc_swap_info(void)
 	INIT_LIST_HEAD(&p->first_swap_extent.list);
 	p->flags = SWP_USED;
 	p->next = -1;
+	atomic_set(&p->ra_hits, 0);
+	p->ra_pages = 0;
 	spin_unlock(&swap_lock);
 
 	return p;
@@ -2298,14 +2300,24 @@ int swapcache_prepare(swp_entry_t entry)
 	return __swap_duplicate(entry, SWAP_HAS_CACHE);
 }
 
+/*
+ * The swap device of an entry the caller holds, through a swap pte or
+ * the swap cache.  swap_info[] slots are never freed, only reused.
+ */
+struct swap_info_struct *swp_swap_info(swp_entry_t entry)
+{
+	return swap_info[swp_type(entry)];
+}
+
 /*
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
+ * The readahead window is the aligned block of (1 << cluster) slots.
  */
-int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
+int valid_swaphandles(swp_entry_t entry, unsigned long *offset, int cluster)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
+	int our_page_cluster = cluster;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
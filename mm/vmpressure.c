@@ -0,0 +1,269 @@
+/*
+ * linux/mm/vmpressure.c
+ *
+ * Reports how hard reclaim has to work for each memory cgroup, as one of
+ * three levels, through eventfds registered on memory.pressure_level.
+ * This lets userspace drop caches or kill tasks before reclaim gets
+ * expensive, rather than after the OOM killer or lowmemorykiller runs.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/fs.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/eventfd.h>
+#include <linux/memcontrol.h>
+#include <linux/vmpressure.h>
+
+/*
+ * Pressure is the share of scanned pages that reclaim failed to free.
+ * It is worked out once every vmpressure_win pages scanned, which is
+ * large enough to smooth out single unlucky batches and small enough
+ * to report in time.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/*
+ * Reclaim falling to this priority means it scanned a large part of
+ * the LRU lists without freeing enough, which is critical right away.
+ */
+static const int vmpressure_level_critical_prio = ilog2(100 / 10);
+
+/*
+ * Once reported, a level is only left when pressure drops this many
+ * points below where it starts, so that listeners are not flooded with
+ * alternating levels while pressure hovers around a boundary.
+ */
+static const unsigned int vmpressure_hysteresis = 10;
+
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+static const char * const vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+/* Pressure, in percent, at which each level starts */
+static const unsigned int vmpressure_level_start[] = {
+	[VMPRESSURE_LOW] = 0,
+	[VMPRESSURE_MEDIUM] = 60,
+	[VMPRESSURE_CRITICAL] = 95,
+};
+
+struct vmpressure_event {
+	struct eventfd_ctx *efd;
+	int level;
+	struct list_head node;
+};
+
+static unsigned long vmpressure_calc_pressure(unsigned long scanned,
+					      unsigned long reclaimed)
+{
+	/* Reclaim may free more than it scanned, e.g. huge pages */
+	if (reclaimed >= scanned)
+		return 0;
+	return (scanned - reclaimed) * 100 / scanned;
+}
+
+/* Called with vmpr->sr_lock held */
+static int vmpressure_level(struct vmpressure *vmpr, unsigned long pressure)
+{
+	int level = VMPRESSURE_NUM_LEVELS - 1;
+
+	while (level > VMPRESSURE_LOW &&
+	       pressure < vmpressure_level_start[level])
+		level--;
+
+	if (level < vmpr->level &&
+	    pressure + vmpressure_hysteresis >=
+	    vmpressure_level_start[vmpr->level])
+		level = vmpr->level;
+
+	return level;
+}
+
+static bool vmpressure_event(struct vmpressure *vmpr, int level)
+{
+	struct vmpressure_event *ev;
+	bool signalled = false;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (level >= ev->level) {
+			eventfd_signal(ev->efd, 1);
+			signalled = true;
+		}
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return signalled;
+}
+
+static void vmpressure_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = container_of(work, struct vmpressure, work);
+	unsigned long scanned, reclaimed;
+	int level;
+
+	spin_lock(&vmpr->sr_lock);
+	scanned = vmpr->scanned;
+	reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	if (!scanned) {
+		spin_unlock(&vmpr->sr_lock);
+		return;
+	}
+	level = vmpressure_level(vmpr,
+			vmpressure_calc_pressure(scanned, reclaimed));
+	vmpr->level = level;
+	spin_unlock(&vmpr->sr_lock);
+
+	/*
+	 * Pressure in a cgroup is pressure on its ancestors too: hand the
+	 * event up the hierarchy until someone listens.
+	 */
+	do {
+		if (vmpressure_event(vmpr, level))
+			break;
+	} while ((vmpr = vmpressure_parent(vmpr)));
+}
+
+/**
+ * vmpressure() - account memory pressure through scanned/reclaimed ratio
+ * @gfp:	reclaimer's gfp mask
+ * @memcg:	cgroup memory controller handle, NULL for global reclaim
+ * @scanned:	number of pages scanned
+ * @reclaimed:	number of pages reclaimed
+ *
+ * Called by reclaim after each pass over a zone.  Once a window's worth
+ * of pages has been scanned the level is worked out and listeners are
+ * signalled, from a work item as eventfd_signal() may sleep.
+ */
+void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure *vmpr;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	/*
+	 * Only allocations that may do I/O, or that go to highmem or
+	 * movable zones, say much about pressure; the others reclaim
+	 * little by design.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	vmpr = memcg_to_vmpressure(memcg);
+	if (!vmpr || !scanned)
+		return;
+
+	spin_lock(&vmpr->sr_lock);
+	vmpr->scanned += scanned;
+	vmpr->reclaimed += reclaimed;
+	scanned = vmpr->scanned;
+	spin_unlock(&vmpr->sr_lock);
+
+	if (scanned < vmpressure_win)
+		return;
+	schedule_work(&vmpr->work);
+}
+
+/**
+ * vmpressure_prio() - account memory pressure through reclaimer priority
+ * @gfp:	reclaimer's gfp mask
+ * @memcg:	cgroup memory controller handle, NULL for global reclaim
+ * @prio:	reclaimer's priority
+ *
+ * Reports critical pressure as soon as reclaim's priority drops low,
+ * without waiting for the rest of the window.
+ */
+void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	/* A full window with nothing reclaimed reads as critical */
+	vmpressure(gfp, memcg, vmpressure_win, 0);
+}
+
+/**
+ * vmpressure_register_event() - bind vmpressure notifications to an eventfd
+ * @vmpr:	vmpressure of the memory cgroup
+ * @eventfd:	eventfd context to signal
+ * @args:	level to be notified of: "low", "medium" or "critical"
+ *
+ * The eventfd is signalled whenever pressure is at the given level or
+ * above.
+ */
+int vmpressure_register_event(struct vmpressure *vmpr,
+			      struct eventfd_ctx *eventfd, const char *args)
+{
+	struct vmpressure_event *ev;
+	int level;
+
+	for (level = 0; level < VMPRESSURE_NUM_LEVELS; level++) {
+		if (!strcmp(vmpressure_str_levels[level], args))
+			break;
+	}
+	if (level == VMPRESSURE_NUM_LEVELS)
+		return -EINVAL;
+
+	ev = kzalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+
+	ev->efd = eventfd;
+	ev->level = level;
+
+	mutex_lock(&vmpr->events_lock);
+	list_add(&ev->node, &vmpr->events);
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+void vmpressure_unregister_event(struct vmpressure *vmpr,
+				 struct eventfd_ctx *eventfd)
+{
+	struct vmpressure_event *ev, *tmp;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry_safe(ev, tmp, &vmpr->events, node) {
+		if (ev->efd != eventfd)
+			continue;
+		list_del(&ev->node);
+		kfree(ev);
+		break;
+	}
+	mutex_unlock(&vmpr->events_lock);
+}
+
+void vmpressure_init(struct vmpressure *vmpr)
+{
+	spin_lock_init(&vmpr->sr_lock);
+	mutex_init(&vmpr->events_lock);
+	INIT_LIST_HEAD(&vmpr->events);
+	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+}
+
+void vmpressure_cleanup(struct vmpressure *vmpr)
+{
+	/* Nothing is listening any more, drop a pending notification */
+	cancel_work_sync(&vmpr->work);
+}
@@ -43,6 +43,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -477,6 +478,23 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 	return PAGE_CLEAN;
 }
 
+/*
+ * Queue a dirty file page for writeback by the flusher threads.  The
+ * page is left dirty; once written it is rotated to the tail of the
+ * inactive list by end_page_writeback() as PageReclaim is set on it.
+ */
+static bool queue_reclaim_writeback(struct page *page,
+				    struct address_space *mapping)
+{
+	if (!mapping || !mapping->a_ops->writepage ||
+	    !mapping_cap_writeback_dirty(mapping))
+		return false;
+	if (bdi_start_inode_writeback(mapping->host, page->index))
+		return false;
+	count_vm_event(PGRECLAIM_WB_QUEUED);
+	return true;
+}
+
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
@@ -827,11 +845,28 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 
 			if (references == PAGEREF_RECLAIM_CLEAN)
 				goto keep_locked;
-			if (!may_enter_fs)
-				goto keep_locked;
 			if (!sc->may_writepage)
 				goto keep_locked;
 
+			/*
+			 * Writing file pages one at a time from here gives
+			 * random I/O, so hand them to the flusher, which
+			 * writes them in clusters per inode.  Direct reclaim
+			 * only waits for that writeback to complete; kswapd
+			 * writes the page itself if it cannot be queued.
+			 */
+			if (page_is_file_cache(page)) {
+				if (queue_reclaim_writeback(page, mapping)) {
+					SetPageReclaim(page);
+					goto keep_locked;
+				}
+				if (!current_is_kswapd())
+					goto keep_locked;
+			}
+
+			if (!may_enter_fs)
+				goto keep_locked;
+
 			/* Page is dirty, try to write it out here */
 			switch (pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
@@ -1939,6 +1974,8 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed, nr_scanned;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long vmpr_scanned = sc->nr_scanned;
+	unsigned long vmpr_reclaimed = sc->nr_reclaimed;
 
 restart:
 	nr_reclaimed = 0;
@@ -1982,6 +2019,10 @@ restart:
 					sc->nr_scanned - nr_scanned, sc))
 		goto restart;
 
+	vmpressure(sc->gfp_mask, sc->mem_cgroup,
+		   sc->nr_scanned - vmpr_scanned,
+		   sc->nr_reclaimed - vmpr_reclaimed);
+
 	throttle_vm_writeout(sc->gfp_mask);
 }
 
@@ -2100,6 +2141,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		count_vm_event(ALLOCSTALL);
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
+		vmpressure_prio(sc->gfp_mask, sc->mem_cgroup, priority);
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token(sc->mem_cgroup);
@@ -602,6 +602,23 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * As fragmentation_index(), for a zone that should keep @reserve blocks
+ * of @order free: the index is worked out as long as fewer are free,
+ * rather than only once an allocation would fail.
+ */
+int fragmentation_index_reserve(struct zone *zone, unsigned int order,
+				unsigned long reserve)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (info.free_blocks_suitable >= reserve)
+		return -1000;
+	info.free_blocks_suitable = 0;
+	return __fragmentation_index(order, &info);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -613,6 +630,9 @@ static char * const migratetype_names[MIGRATE_TYPES] = {
 	"Reclaimable",
 	"Movable",
 	"Reserve",
+#ifdef CONFIG_CMA_MIGRATE
+	"CMA",
+#endif
 	"Isolate",
 };
 
@@ -726,6 +746,8 @@ const char * const vmstat_text[] = {
 	"pgpgout",
 	"pswpin",
 	"pswpout",
+	"swap_ra",
+	"swap_ra_hit",
 
 	TEXTS_FOR_ZONES("pgalloc")
 
@@ -755,6 +777,9 @@ const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pgreclaim_wb_queued",
+	"pgreclaim_wb_clusters",
+	"pgreclaim_wb_pages",
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -763,6 +788,10 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_stall_us",
+	"compact_daemon_wake",
+	"compact_daemon_blocks",
+	"compact_daemon_us",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -781,8 +810,10 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	"thp_fault_alloc",
 	"thp_fault_fallback",
+	"thp_cow_fallback",
 	"thp_collapse_alloc",
 	"thp_collapse_alloc_failed",
+	"thp_collapse",
 	"thp_split",
 #endif
 